@@ -0,0 +1,113 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "bootstage.h"
+#include "params.h"
+#include "param_save.h"
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+namespace
+{
+   uint32_t stageStart[BootStage::STAGE_LAST];
+   uint32_t stageEnd[BootStage::STAGE_LAST];
+   bool mapsStarted = false;
+   bool mapsDone = false;
+
+   uint32_t Now()
+   {
+#ifdef ARDUINO
+      return micros();
+#else
+      return 0;
+#endif
+   }
+}
+
+namespace BootStage
+{
+   /** \brief Load default and saved parameter values
+    *
+    * \return result of parm_load()
+    *
+    */
+   int LoadParams()
+   {
+      stageStart[STAGE_PARAMS] = Now();
+      Param::LoadDefaults();
+      int result = parm_load();
+      stageEnd[STAGE_PARAMS] = Now();
+      return result;
+   }
+
+   /** \brief Record the end of an application defined stage
+    * The stage is assumed to have started when the previous one ended
+    */
+   void Mark(STAGE stage)
+   {
+      if (stage >= STAGE_LAST) return;
+
+      stageStart[stage] = stage > 0 ? stageEnd[stage - 1] : 0;
+      stageEnd[stage] = Now();
+   }
+
+   /** \brief Load CAN map from flash in chunks, call from loop()
+    *
+    * \param canMap CanMap* that was constructed with loadFromFlash = false
+    * \return true while loading is still in progress
+    *
+    */
+   bool LoadMaps(CanMap* canMap)
+   {
+      if (mapsDone) return false;
+
+      if (!mapsStarted)
+      {
+         mapsStarted = true;
+         stageStart[STAGE_MAPS] = Now();
+         canMap->StartLoad();
+      }
+
+      if (canMap->LoadChunk()) return true;
+
+      mapsDone = true;
+      stageEnd[STAGE_MAPS] = Now();
+      return false;
+   }
+
+   /** \brief Get the time a stage was completed
+    *
+    * \return time in us since power-on, 0 when not completed
+    *
+    */
+   uint32_t GetStageEnd(STAGE stage)
+   {
+      return stage < STAGE_LAST ? stageEnd[stage] : 0;
+   }
+
+   /** \brief Get the time a stage took from start to completion
+    *
+    * \return time in us
+    *
+    */
+   uint32_t GetStageDuration(STAGE stage)
+   {
+      return stage < STAGE_LAST ? stageEnd[stage] - stageStart[stage] : 0;
+   }
+}
@@ -0,0 +1,48 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BOOTSTAGE_H
+#define BOOTSTAGE_H
+
+#include <stdint.h>
+#include "canmap.h"
+
+/* Staged start-up:
+   1. LoadParams() in setup(): defaults and saved parameters
+   2. Mark(STAGE_CAN) once the CAN interface is running
+   3. LoadMaps() from loop() until it returns false, CAN maps are read in chunks
+   The parameter JSON is only built when it is first requested via SDO.
+ */
+namespace BootStage
+{
+   enum STAGE
+   {
+      STAGE_PARAMS,
+      STAGE_CAN,
+      STAGE_MAPS,
+      STAGE_LAST
+   };
+
+   int LoadParams();
+   void Mark(STAGE stage);
+   bool LoadMaps(CanMap* canMap);
+   uint32_t GetStageEnd(STAGE stage);
+   uint32_t GetStageDuration(STAGE stage);
+}
+
+#endif // BOOTSTAGE_H
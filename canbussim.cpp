@@ -0,0 +1,421 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ARDUINO
+#include "canbussim.h"
+#include <string.h>
+
+#define CRC15_POLY        0x4599
+//CRC delimiter, ACK slot and delimiter, end of frame, intermission
+#define TRAILER_BITS      13
+//Error flag, echoed flags and delimiter, intermission
+#define ERROR_FRAME_BITS  17
+#define TEC_ERROR         8
+#define TEC_ACK_PASSIVE   128 //ack errors do not raise the counter beyond this
+
+static const uint32_t bitTimes[] = { 8000, 4000, 2000, 1250, 1000 };
+
+static bool IsExtended(uint32_t canId)
+{
+   return canId > 0x7FF;
+}
+
+//Lower value wins arbitration, RTR/SRR and IDE follow the base id
+static uint64_t ArbitrationKey(uint32_t canId)
+{
+   canId &= 0x1FFFFFFF;
+
+   if (IsExtended(canId))
+      return ((uint64_t)(canId >> 18) << 20) | (1 << 19) | (1 << 18) | (canId & 0x3FFFF);
+   return (uint64_t)canId << 20;
+}
+
+/** \brief Create bus
+ *
+ * \param baudrate nodes with a different baud rate neither send nor receive
+ *
+ */
+CanBusSim::CanBusSim(enum CanHardware::baudrates baudrate)
+ : numNodes(0), baudrate(baudrate), bitTime(bitTimes[baudrate < CanHardware::BaudLast ? baudrate : CanHardware::Baud500]),
+   now(0), sender(nullptr), busyUntil(0), corrupted(false), acked(false), errorRate(0), errorId(0), errorCount(0), random(1),
+   loadInterval(0), loadStart(0), loadTime(0), loadBusy(0), loadCallback(nullptr)
+{
+   memset(&stats, 0, sizeof(stats));
+}
+
+/** \brief Connect node to bus, called by CanHardwareSim */
+bool CanBusSim::Attach(CanHardwareSim* node)
+{
+   if (numNodes >= CANSIM_MAX_NODES) return false;
+
+   nodes[numNodes++] = node;
+   return true;
+}
+
+/** \brief Report the bus load
+ *
+ * \param interval length of the intervals in ns
+ * \param callback called with start time and load (0..1) of every interval
+ *
+ */
+void CanBusSim::SetLoadCallback(uint64_t interval, void (*callback)(uint64_t time, float load))
+{
+   loadInterval = interval;
+   loadCallback = callback;
+   loadStart = now;
+   loadTime = now;
+   loadBusy = 0;
+}
+
+/** \brief Transmit queued frames until time or the bus is idle
+ * Frames sent before calling this compete for the bus from the current bus time.
+ *
+ * \param time bus time in ns to advance to
+ *
+ */
+void CanBusSim::RunUntil(uint64_t time)
+{
+   while (now < time)
+   {
+      if (sender == nullptr)
+      {
+         StartFrame();
+
+         if (sender == nullptr)
+         {
+            Account(time, false);
+            now = time;
+         }
+      }
+      else if (busyUntil <= time)
+      {
+         now = busyUntil;
+         Account(now, true);
+         EndFrame();
+      }
+      else
+      {
+         Account(time, true);
+         now = time;
+      }
+   }
+}
+
+/** \brief Number of bits on the bus for a frame without errors, including stuff bits
+ *
+ * \param canId identifier, extended when > 0x7FF
+ * \param data payload
+ * \param len data length
+ * \return int frame bits including intermission
+ *
+ */
+int CanBusSim::FrameBits(uint32_t canId, const uint8_t* data, uint8_t len)
+{
+   uint8_t bits[128];
+   int n = 0;
+   uint16_t crc = 0;
+
+   canId &= 0x1FFFFFFF;
+   bits[n++] = 0; //SOF
+
+   if (IsExtended(canId))
+   {
+      for (int i = 28; i >= 18; i--) bits[n++] = (canId >> i) & 1;
+      bits[n++] = 1; //SRR
+      bits[n++] = 1; //IDE
+      for (int i = 17; i >= 0; i--) bits[n++] = (canId >> i) & 1;
+      bits[n++] = 0; //RTR
+      bits[n++] = 0; //r1
+      bits[n++] = 0; //r0
+   }
+   else
+   {
+      for (int i = 10; i >= 0; i--) bits[n++] = (canId >> i) & 1;
+      bits[n++] = 0; //RTR
+      bits[n++] = 0; //IDE
+      bits[n++] = 0; //r0
+   }
+
+   for (int i = 3; i >= 0; i--) bits[n++] = (len >> i) & 1;
+
+   for (int i = 0; i < len && i < 8; i++)
+   {
+      for (int b = 7; b >= 0; b--) bits[n++] = (data[i] >> b) & 1;
+   }
+
+   for (int i = 0; i < n; i++)
+   {
+      bool top = (crc >> 14) & 1;
+      crc = (crc << 1) & 0x7FFF;
+      if (top ^ bits[i]) crc ^= CRC15_POLY;
+   }
+
+   for (int i = 14; i >= 0; i--) bits[n++] = (crc >> i) & 1;
+
+   //After 5 equal bits a complementary stuff bit is inserted which starts the next run
+   int stuffBits = 0;
+   int run = 0;
+   int last = -1;
+
+   for (int i = 0; i < n; i++)
+   {
+      if (bits[i] == last)
+      {
+         run++;
+      }
+      else
+      {
+         run = 1;
+         last = bits[i];
+      }
+
+      if (run == 5)
+      {
+         stuffBits++;
+         last = !bits[i];
+         run = 1;
+      }
+   }
+
+   return n + stuffBits + TRAILER_BITS;
+}
+
+void CanBusSim::StartFrame()
+{
+   CanHardwareSim* winner = nullptr;
+   uint64_t winnerKey = 0;
+
+   for (int i = 0; i < numNodes; i++)
+   {
+      CanHardwareSim* node = nodes[i];
+
+      if (node->txCount == 0 || !node->OnBus()) continue;
+
+      uint64_t key = ArbitrationKey(node->txQueue[node->txHead].canId);
+
+      if (winner == nullptr || key < winnerKey)
+      {
+         winner = node;
+         winnerKey = key;
+      }
+   }
+
+   if (winner == nullptr) return;
+
+   const CanHardwareSim::FRAME& frame = winner->txQueue[winner->txHead];
+   int bits = FrameBits(frame.canId, (const uint8_t*)frame.data, frame.len);
+
+   acked = false;
+
+   for (int i = 0; i < numNodes; i++)
+   {
+      if (nodes[i] != winner && nodes[i]->OnBus())
+         acked = true;
+   }
+
+   corrupted = !acked || Corrupt(frame.canId);
+
+   if (corrupted)
+      bits = bits - TRAILER_BITS + ERROR_FRAME_BITS;
+
+   sender = winner;
+   busyUntil = now + (uint64_t)bits * bitTime;
+   stats.busyTime += busyUntil - now;
+}
+
+void CanBusSim::EndFrame()
+{
+   CanHardwareSim* node = sender;
+
+   sender = nullptr;
+
+   if (corrupted)
+   {
+      stats.errorFrames++;
+      node->Transmitted(true, acked);
+      return;
+   }
+
+   CanHardwareSim::FRAME frame = node->txQueue[node->txHead];
+
+   frame.canId &= 0x1FFFFFFF;
+   frame.time = now;
+   stats.frames++;
+
+   for (int i = 0; i < numNodes; i++)
+   {
+      if (nodes[i] != node && nodes[i]->OnBus())
+         nodes[i]->Receive(frame);
+   }
+
+   node->Transmitted(false, true);
+}
+
+//Decides whether the frame that starts now is destroyed by an error
+bool CanBusSim::Corrupt(uint32_t canId)
+{
+   if (errorCount > 0 && (canId & 0x1FFFFFFF) == (errorId & 0x1FFFFFFF))
+   {
+      errorCount--;
+      return true;
+   }
+
+   if (errorRate <= 0) return false;
+
+   //xorshift32
+   random ^= random << 13;
+   random ^= random >> 17;
+   random ^= random << 5;
+
+   return random < errorRate * 4294967296.0;
+}
+
+//Adds the time up to until to the current load interval, reports finished intervals
+void CanBusSim::Account(uint64_t until, bool busy)
+{
+   if (loadCallback == nullptr || loadInterval == 0) return;
+
+   while (loadTime < until)
+   {
+      uint64_t end = loadStart + loadInterval;
+      uint64_t step = until < end ? until : end;
+
+      if (busy) loadBusy += step - loadTime;
+      loadTime = step;
+
+      if (loadTime == end)
+      {
+         loadCallback(loadStart, (float)loadBusy / loadInterval);
+         loadStart = end;
+         loadBusy = 0;
+      }
+   }
+}
+
+/** \brief Create node and attach it to bus, it starts with the baud rate of the bus */
+CanHardwareSim::CanHardwareSim(CanBusSim& bus)
+ : CanHardware(), bus(bus), baudrate(bus.GetBaudrate()), txHead(0), txCount(0), rxHead(0), rxCount(0), tec(0)
+{
+   memset(&stats, 0, sizeof(stats));
+   stats.latencyMin = UINT64_MAX;
+   bus.Attach(this);
+}
+
+/** \brief Set baud rate, this also restarts the controller after bus off */
+void CanHardwareSim::SetBaudrate(enum baudrates baudrate)
+{
+   this->baudrate = baudrate;
+   tec = 0;
+}
+
+/** \brief Queue frame for transmission, frames are sent in the order of Send() */
+void CanHardwareSim::Send(uint32_t canId, uint32_t data[2], uint8_t len)
+{
+   if (txCount >= CANSIM_TX_QUEUE || IsBusOff())
+   {
+      stats.txDropped++;
+      return;
+   }
+
+   FRAME& frame = txQueue[(txHead + txCount) % CANSIM_TX_QUEUE];
+
+   frame.canId = canId;
+   frame.data[0] = data[0];
+   frame.data[1] = data[1];
+   frame.len = len > 8 ? 8 : len;
+   frame.time = bus.GetTime();
+   txCount++;
+
+   if (txCount > stats.maxQueued)
+      stats.maxQueued = txCount;
+}
+
+void CanHardwareSim::ConfigureFilters()
+{
+   // Accept all frames like the Teensy driver
+}
+
+/** \brief Pass received frames to the registered callbacks */
+void CanHardwareSim::Poll()
+{
+   while (rxCount > 0)
+   {
+      FRAME frame = rxQueue[rxHead];
+
+      rxHead = (rxHead + 1) % CANSIM_RX_QUEUE;
+      rxCount--;
+
+      lastRxTimestamp = frame.time / 1000000;
+      HandleRx(frame.canId, frame.data, frame.len);
+   }
+}
+
+void CanHardwareSim::Receive(const FRAME& frame)
+{
+   if (rxCount >= CANSIM_RX_QUEUE)
+   {
+      stats.rxOverruns++;
+      return;
+   }
+
+   FRAME& slot = rxQueue[(rxHead + rxCount) % CANSIM_RX_QUEUE];
+
+   slot = frame;
+
+   //Unused bytes read as 0 as with memcpy() from the driver
+   if (slot.len < 8)
+   {
+      uint8_t* bytes = (uint8_t*)slot.data;
+      memset(bytes + slot.len, 0, 8 - slot.len);
+   }
+   rxCount++;
+   stats.rxFrames++;
+}
+
+//End of transmission of the head of the queue, it is sent again after an error
+void CanHardwareSim::Transmitted(bool error, bool acked)
+{
+   if (error)
+   {
+      stats.txErrors++;
+
+      if (acked || tec < TEC_ACK_PASSIVE)
+         tec += TEC_ERROR;
+
+      if (IsBusOff())
+      {
+         stats.txDropped += txCount;
+         txCount = 0;
+      }
+      return;
+   }
+
+   uint64_t latency = bus.GetTime() - txQueue[txHead].time;
+
+   stats.txFrames++;
+   stats.latencySum += latency;
+   if (latency < stats.latencyMin) stats.latencyMin = latency;
+   if (latency > stats.latencyMax) stats.latencyMax = latency;
+
+   txHead = (txHead + 1) % CANSIM_TX_QUEUE;
+   txCount--;
+
+   if (tec > 0) tec--;
+}
+
+#endif // ARDUINO
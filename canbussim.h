@@ -0,0 +1,158 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CANBUSSIM_H
+#define CANBUSSIM_H
+
+#ifndef ARDUINO
+#include "canhardware.h"
+
+#ifndef CANSIM_MAX_NODES
+#define CANSIM_MAX_NODES  32
+#endif
+
+#ifndef CANSIM_TX_QUEUE
+#define CANSIM_TX_QUEUE   32
+#endif
+
+#ifndef CANSIM_RX_QUEUE
+#define CANSIM_RX_QUEUE   64
+#endif
+
+class CanHardwareSim;
+
+/* Host build only: discrete event simulation of one CAN bus. All times are in ns.
+   RunUntil() transmits the queued frames of the attached nodes one after the other.
+   When the bus becomes idle the frame with the lowest identifier wins arbitration,
+   each node offers the oldest frame of its queue. Frame lengths include the stuff bits
+   of the actual frame, the CRC delimiter, ACK, end of frame and intermission.
+   Errors are injected per frame; a corrupted frame is followed by an error frame and
+   sent again, and the transmit error counter can take the sender bus off.
+   Bus load is reported per interval through the load callback.
+ */
+class CanBusSim
+{
+   public:
+      struct STATS
+      {
+         uint32_t frames;
+         uint32_t errorFrames;
+         uint64_t busyTime;
+      };
+
+      explicit CanBusSim(enum CanHardware::baudrates baudrate = CanHardware::Baud500);
+      bool Attach(CanHardwareSim* node);
+      void RunUntil(uint64_t time);
+      uint64_t GetTime() { return now; }
+      uint32_t GetBitTime() { return bitTime; }
+      enum CanHardware::baudrates GetBaudrate() { return baudrate; }
+      void SetErrorRate(float probability) { errorRate = probability; }
+      void InjectErrors(uint32_t canId, int count) { errorId = canId; errorCount = count; }
+      void SetSeed(uint32_t seed) { random = seed != 0 ? seed : 1; }
+      void SetLoadCallback(uint64_t interval, void (*callback)(uint64_t time, float load));
+      const STATS& GetStats() { return stats; }
+      static int FrameBits(uint32_t canId, const uint8_t* data, uint8_t len);
+
+   private:
+      CanHardwareSim* nodes[CANSIM_MAX_NODES];
+      int numNodes;
+      enum CanHardware::baudrates baudrate;
+      uint32_t bitTime;
+      uint64_t now;
+      CanHardwareSim* sender;  //node whose frame is on the bus, 0 when idle
+      uint64_t busyUntil;
+      bool corrupted;
+      bool acked;              //another node was there to acknowledge
+      float errorRate;
+      uint32_t errorId;
+      int errorCount;
+      uint32_t random;
+      STATS stats;
+      uint64_t loadInterval;
+      uint64_t loadStart;
+      uint64_t loadTime;
+      uint64_t loadBusy;
+      void (*loadCallback)(uint64_t time, float load);
+
+      void StartFrame();
+      void EndFrame();
+      void Account(uint64_t until, bool busy);
+      bool Corrupt(uint32_t canId);
+};
+
+/* CanHardware on a CanBusSim. Send() queues the frame, Poll() passes received
+   frames to the callbacks as on real hardware. Every node has its own CanMap and
+   CanSdo, but Param is global: all nodes in one process share the parameters.
+ */
+class CanHardwareSim: public CanHardware
+{
+   public:
+      struct STATS
+      {
+         uint32_t txFrames;
+         uint32_t rxFrames;
+         uint32_t txErrors;
+         uint32_t txDropped;   //queue full or bus off
+         uint32_t rxOverruns;
+         uint64_t latencySum;  //from Send() to the end of the successful transmission
+         uint64_t latencyMin;
+         uint64_t latencyMax;
+         uint8_t maxQueued;
+      };
+
+      explicit CanHardwareSim(CanBusSim& bus);
+      void SetBaudrate(enum baudrates baudrate) override;
+      void Send(uint32_t canId, uint32_t data[2], uint8_t len) override;
+      void Poll();
+      bool IsBusOff() { return tec > 255; }
+      uint16_t GetTransmitErrors() { return tec; }
+      const STATS& GetStats() { return stats; }
+
+   protected:
+      void ConfigureFilters() override;
+
+   private:
+      friend class CanBusSim;
+
+      struct FRAME
+      {
+         uint32_t canId;
+         uint32_t data[2];
+         uint8_t len;
+         uint64_t time;    //queued or received
+      };
+
+      CanBusSim& bus;
+      enum baudrates baudrate;
+      FRAME txQueue[CANSIM_TX_QUEUE];
+      uint8_t txHead;
+      uint8_t txCount;
+      FRAME rxQueue[CANSIM_RX_QUEUE];
+      uint8_t rxHead;
+      uint8_t rxCount;
+      uint16_t tec;
+      STATS stats;
+
+      bool OnBus() { return baudrate == bus.GetBaudrate() && !IsBusOff(); }
+      void Receive(const FRAME& frame);
+      void Transmitted(bool error, bool acked);
+};
+
+#endif // ARDUINO
+
+#endif // CANBUSSIM_H
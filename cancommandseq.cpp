@@ -0,0 +1,138 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "cancommandseq.h"
+#include <string.h>
+
+/** \brief Non-blocking CAN command sequencer
+ *
+ * \param hw CanHardware* to send commands and receive replies on
+ *
+ */
+CanCommandSequence::CanCommandSequence(CanHardware* hw)
+ : canHardware(hw), steps(0), numSteps(0), current(0), state(Idle), stepStart(0),
+   waitReply(false), gotReply(false)
+{
+   memset(reply, 0, sizeof(reply));
+}
+
+//Somebody (perhaps us) has cleared all user messages. Register them again
+void CanCommandSequence::HandleClear()
+{
+   if (state == Running && waitReply)
+      canHardware->RegisterUserMessage(steps[current].replyId);
+}
+
+void CanCommandSequence::HandleRx(uint32_t canId, uint32_t data[2], uint8_t dlc)
+{
+   if (waitReply && !gotReply && canId == steps[current].replyId)
+   {
+      memcpy(reply, data, dlc < 8 ? dlc : 8);
+      gotReply = true;
+   }
+}
+
+/** \brief Start a sequence, the first step is sent after its delay
+ *
+ * \param stepTable table of steps, must stay valid until the sequence is done
+ * \param count number of steps
+ * \param time current time in ms, e.g. millis()
+ * \return true: started, false: another sequence is running
+ *
+ */
+bool CanCommandSequence::Start(const STEP* stepTable, int count, uint32_t time)
+{
+   if (state == Running) return false;
+
+   steps = stepTable;
+   numSteps = count;
+   current = 0;
+   waitReply = false;
+   gotReply = false;
+   stepStart = time;
+   state = count > 0 ? Running : Done;
+   return true;
+}
+
+void CanCommandSequence::Abort()
+{
+   if (state == Running)
+   {
+      waitReply = false;
+      state = Failed;
+   }
+}
+
+/** \brief Advance the sequence, call from loop()
+ *
+ * \param time current time in ms, e.g. millis()
+ * \return state after processing
+ *
+ */
+enum CanCommandSequence::states CanCommandSequence::Run(uint32_t time)
+{
+   if (state != Running) return state;
+
+   const STEP& step = steps[current];
+
+   if (waitReply)
+   {
+      if (gotReply)
+      {
+         waitReply = false;
+         NextStep(time);
+      }
+      else if ((time - stepStart) > step.timeout)
+      {
+         waitReply = false;
+         state = Failed;
+      }
+   }
+   else if ((time - stepStart) >= step.delay)
+   {
+      uint32_t data[2] = { 0, 0 };
+
+      memcpy(data, step.data, step.len);
+
+      if (step.replyId != 0)
+      {
+         gotReply = false;
+         waitReply = true;
+         canHardware->RegisterUserMessage(step.replyId);
+      }
+
+      canHardware->Send(step.canId, data, step.len);
+      stepStart = time;
+
+      if (!waitReply)
+         NextStep(time);
+   }
+
+   return state;
+}
+
+/****************** Private methods ********************/
+
+void CanCommandSequence::NextStep(uint32_t time)
+{
+   current++;
+   stepStart = time;
+
+   if (current >= numSteps)
+      state = Done;
+}
@@ -0,0 +1,73 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CANCOMMANDSEQ_H
+#define CANCOMMANDSEQ_H
+#include "canhardware.h"
+
+/* Sends a table of CAN frames from the main loop without blocking, e.g. to configure a sensor.
+   Each step waits delay ms after the previous step, sends its frame and then optionally waits
+   up to timeout ms for a frame with replyId. A missing reply stops the sequence as failed.
+ */
+class CanCommandSequence: CanCallback
+{
+   public:
+      struct STEP
+      {
+         uint32_t canId;
+         uint8_t data[8];
+         uint8_t len;
+         uint16_t delay;
+         uint32_t replyId; //0: don't wait for a reply
+         uint16_t timeout;
+      };
+
+      enum states
+      {
+         Idle,
+         Running,
+         Done,
+         Failed
+      };
+
+      explicit CanCommandSequence(CanHardware* hw);
+      void HandleClear() override;
+      void HandleRx(uint32_t canId, uint32_t data[2], uint8_t dlc) override;
+      bool Start(const STEP* steps, int count, uint32_t time);
+      void Abort();
+      enum states Run(uint32_t time);
+      enum states GetState() { return state; }
+      bool IsBusy() { return state == Running; }
+      int GetStep() { return current; }
+      const uint8_t* GetReply() { return reply; }
+
+   private:
+      CanHardware* canHardware;
+      const STEP* steps;
+      int numSteps;
+      int current;
+      enum states state;
+      uint32_t stepStart;
+      volatile bool waitReply;
+      volatile bool gotReply;
+      uint8_t reply[8];
+
+      void NextStep(uint32_t time);
+};
+
+#endif // CANCOMMANDSEQ_H
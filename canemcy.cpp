@@ -0,0 +1,77 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "canemcy.h"
+#include "errormessage.h"
+
+/** \brief EMCY producer for errors posted to ErrorMessage
+ *
+ * \param hw CanHardware*
+ * \param nmt CanNmt* optional, no EMCY is sent in stopped state
+ *
+ */
+CanEmcy::CanEmcy(CanHardware* hw, CanNmt* nmt)
+ : canHardware(hw), canNmt(nmt), nodeId(1), inhibitTime(100), lastSend(0),
+   nextPos(ErrorMessage::GetPosition()), lostCount(0)
+{
+}
+
+/** \brief Send at most one EMCY message per inhibit time for new log entries
+ *
+ * \param time current time in ms, e.g. millis()
+ * \return void
+ *
+ */
+void CanEmcy::Task(uint32_t time)
+{
+   uint32_t writePos = ErrorMessage::GetPosition();
+
+   if (nextPos == writePos || (time - lastSend) < inhibitTime) return;
+   if (canNmt != 0 && (canNmt->GetState() == CanNmt::Stopped || canNmt->GetState() == CanNmt::BootUp)) return;
+
+   //Entries we did not get to send before they were overwritten
+   if ((writePos - nextPos) > ERROR_BUF_SIZE)
+   {
+      lostCount += writePos - nextPos - ERROR_BUF_SIZE;
+      nextPos = writePos - ERROR_BUF_SIZE;
+   }
+
+   ERROR_MESSAGE_NUM err;
+   uint32_t errTime;
+   uint16_t count;
+
+   if (ErrorMessage::ReadEntry(nextPos, err, errTime, count))
+   {
+      uint16_t code = EMCY_CODE_DEVICE | (err & 0xFF);
+      uint8_t bytes[8] =
+      {
+         (uint8_t)code, (uint8_t)(code >> 8), EMCY_REG_GENERIC,
+         (uint8_t)count, (uint8_t)(count >> 8),
+         (uint8_t)errTime, (uint8_t)(errTime >> 8), (uint8_t)(errTime >> 16)
+      };
+
+      canHardware->Send(EMCY_ID_BASE + nodeId, bytes, 8);
+      lastSend = time;
+      nextPos++;
+   }
+   else if ((writePos - nextPos) == ERROR_BUF_SIZE)
+   {
+      nextPos++; //overwritten while we were reading it
+      lostCount++;
+   }
+}
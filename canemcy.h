@@ -0,0 +1,47 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CANEMCY_H
+#define CANEMCY_H
+#include "canhardware.h"
+#include "cannmt.h"
+
+#define EMCY_ID_BASE          0x80U
+#define EMCY_CODE_DEVICE      0xFF00 //Device specific error code, low byte is error number
+#define EMCY_REG_GENERIC      0x01
+
+class CanEmcy
+{
+   public:
+      explicit CanEmcy(CanHardware* hw, CanNmt* nmt = 0);
+      void SetNodeId(uint8_t id) { nodeId = id; }
+      void SetInhibitTime(uint16_t time) { inhibitTime = time; }
+      uint32_t GetLostCount() { return lostCount; }
+      void Task(uint32_t time);
+
+   private:
+      CanHardware* canHardware;
+      CanNmt* canNmt;
+      uint8_t nodeId;
+      uint16_t inhibitTime;
+      uint32_t lastSend;
+      uint32_t nextPos;
+      uint32_t lostCount;
+};
+
+#endif // CANEMCY_H
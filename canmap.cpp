@@ -4,10 +4,13 @@
  */
 #include <Arduino.h>
 #include <EEPROM.h>
+#include <stddef.h>
+#include <string.h>
 #include "canmap.h"
+#include "crc32.h"
 #include "my_math.h"
 
-static const int kCanMapEepromBase = 2048;
+static const int kCanMapEepromBase = CANMAP_EEPROM_BASE;
 
 #define ITEM_UNSET            0xff
 #define forEachCanMap(c,m) for (CANIDMAP *c = m; (c - m) < MAX_MESSAGES && c->first != MAX_ITEMS; c++)
@@ -25,27 +28,39 @@ static const int kCanMapEepromBase = 2048;
 
 volatile bool CanMap::isSaving = false;
 
-// Simple CRC32 for flash verification
-static uint32_t calculate_crc32_block(uint32_t *data, uint32_t length)
+struct RawRange
 {
-   uint32_t crc = 0xFFFFFFFF;
-   for (uint32_t i = 0; i < length; i++)
+   float min;
+   float max;
+};
+
+//Largest float not above 2^bits - 1. Above 24 bits float can't hold the odd values
+static constexpr float MaxRaw(int bits)
+{
+   return bits > 24 ? (float)((1ULL << bits) - (1ULL << (bits - 24))) : (float)((1ULL << bits) - 1);
+}
+
+//Representable values of a field, indexed by [signed][numBits]
+struct RawRangeTable
+{
+   RawRange range[2][33];
+
+   constexpr RawRangeTable() : range()
    {
-      crc ^= data[i];
-      for (int j = 0; j < 32; j++)
+      for (int bits = 1; bits <= 32; bits++)
       {
-         if (crc & 1)
-            crc = (crc >> 1) ^ 0xEDB88320;
-         else
-            crc = crc >> 1;
+         range[0][bits] = { 0, MaxRaw(bits) };
+         range[1][bits] = { -MaxRaw(bits - 1) - 1, MaxRaw(bits - 1) };
       }
    }
-   return ~crc;
-}
+};
+
+static constexpr RawRangeTable kRawRange;
 
 CanMap::CanMap(CanHardware* hw, bool loadFromFlash)
- : canHardware(hw)
+ : canHardware(hw), sendEnabled(true), isLoading(false), loadOffset(0), loadCrc(0), numRxFilters(0)
 {
+   memset(overflowCount, 0, sizeof(overflowCount));
    ClearMap(canSendMap);
    ClearMap(canRecvMap);
    if (loadFromFlash) LoadFromFlash();
@@ -63,7 +78,7 @@ void CanMap::HandleClear()
 
 void CanMap::HandleRx(uint32_t canId, uint32_t data[2], uint8_t)
 {
-   if (isSaving) return;
+   if (isSaving || isLoading) return;
 
    CANIDMAP *recvMap = FindById(canRecvMap, canId);
 
@@ -71,9 +86,16 @@ void CanMap::HandleRx(uint32_t canId, uint32_t data[2], uint8_t)
    {
       forEachPosMap(curPos, recvMap)
       {
+         uint8_t numBits = ABS(curPos->numBits);
+
+         if (numBits > 32)
+         {
+            HandleRxWide(curPos, data);
+            continue;
+         }
+
          uint32_t word;
          uint8_t pos = curPos->offsetBits;
-         uint8_t numBits = ABS(curPos->numBits);
 
          if (curPos->numBits < 0) // big endian
          {
@@ -117,32 +139,31 @@ void CanMap::HandleRx(uint32_t canId, uint32_t data[2], uint8_t)
             }
          }
 
-         uint32_t mask = (1L << numBits) - 1;
+         uint32_t mask = numBits < 32 ? (1UL << numBits) - 1 : 0xFFFFFFFF;
          word = (word >> pos) & mask;
 
-         #if CAN_SIGNED
-            int32_t ival;
-            if (numBits > 1)
-            {
-               uint32_t sign_bit = 1L << (numBits - 1);
-               ival = static_cast<int32_t>(((word + sign_bit) & mask)) - sign_bit;
-            }
-            else
-            {
-               ival = word;
-            }
-            float val = ival;
-         #else
-            float val = word;
-         #endif
+         if (curPos->type == ITEM_RAW)
+         {
+            Param::SetRaw((Param::PARAM_NUM)curPos->mapParam, word);
+            continue;
+         }
+
+         int64_t raw = word;
 
+         if (IsSigned(curPos) && numBits > 1)
+         {
+            uint32_t sign_bit = 1UL << (numBits - 1);
+            raw = (int64_t)word - ((word & sign_bit) ? (1LL << numBits) : 0);
+         }
+
+         if (numRxFilters > 0)
+            raw = ApplyFilter(curPos->mapParam, raw);
+
+         float val = raw;
          val += curPos->offset;
          val *= curPos->gain;
 
-         if (Param::GetType((Param::PARAM_NUM)curPos->mapParam) == Param::TYPE_PARAM || Param::GetType((Param::PARAM_NUM)curPos->mapParam) == Param::TYPE_TESTPARAM)
-            Param::Set((Param::PARAM_NUM)curPos->mapParam, FP_FROMFLT(val));
-         else
-            Param::SetFloat((Param::PARAM_NUM)curPos->mapParam, val);
+         StoreRecv(curPos, val);
       }
    }
 }
@@ -156,6 +177,8 @@ void CanMap::Clear()
 
 void CanMap::SendAll()
 {
+   if (!sendEnabled || isLoading) return;
+
    forEachCanMap(curMap, canSendMap)
    {
       uint32_t data[2] = { 0 };
@@ -164,13 +187,40 @@ void CanMap::SendAll()
       {
          if (isSaving) return;
 
-         float val = Param::GetFloat((Param::PARAM_NUM)curPos->mapParam);
-
-         val *= curPos->gain;
-         val += curPos->offset;
-         uint32_t ival = (int32_t)val;
          uint8_t numBits = ABS(curPos->numBits);
-         ival &= (1UL << numBits) - 1;
+
+         if (numBits > 32)
+         {
+            SendWide(curPos, data);
+            continue;
+         }
+
+         uint32_t ival;
+
+         if (curPos->type == ITEM_RAW)
+         {
+            ival = Param::GetRaw((Param::PARAM_NUM)curPos->mapParam);
+         }
+         else
+         {
+            float val = Param::GetFloat((Param::PARAM_NUM)curPos->mapParam);
+
+            val *= curPos->gain;
+            val += curPos->offset;
+            bool isSigned = IsSigned(curPos);
+            const RawRange& range = kRawRange.range[isSigned][numBits];
+
+            //Saturate instead of wrapping around, e.g. negative values in unsigned fields
+            if (val < range.min || val > range.max)
+            {
+               val = val < range.min ? range.min : range.max;
+               CountOverflow(curPos);
+            }
+
+            ival = isSigned ? (uint32_t)(int32_t)val : (uint32_t)val;
+         }
+
+         if (numBits < 32) ival &= (1UL << numBits) - 1;
 
          if (curPos->numBits < 0) // big-endian
          {
@@ -213,10 +263,27 @@ void CanMap::SendAll()
    }
 }
 
-int CanMap::AddSend(Param::PARAM_NUM param, uint32_t canId, uint8_t offsetBits, int8_t length, float gain, int8_t offset)
+/** \brief Map a parameter to a sent CAN message
+ *
+ * \param param parameter index
+ * \param canId CAN id, OR with CAN_FORCE_EXTENDED for 29-bit ids below 0x800
+ * \param offsetBits bit position of the value
+ * \param length number of bits, up to 64, negative for big endian
+ * \param gain value is multiplied by this before sending
+ * \param offset added after multiplying
+ * \param type signedness or ITEM_RAW for integer passthrough
+ * \return number of sent messages or CAN_ERR_*
+ *
+ */
+int CanMap::AddSend(Param::PARAM_NUM param, uint32_t canId, uint8_t offsetBits, int8_t length, float gain, int8_t offset, enum itemtypes type)
 {
    if (canId > MAX_COB_ID) return CAN_ERR_INVALID_ID;
-   return Add(canSendMap, param, canId, offsetBits, length, gain, offset);
+   return Add(canSendMap, param, canId, offsetBits, length, gain, offset, type);
+}
+
+int CanMap::AddSend(Param::PARAM_NUM param, uint32_t canId, uint8_t offsetBits, int8_t length, float gain, int8_t offset)
+{
+   return AddSend(param, canId, offsetBits, length, gain, offset, ITEM_DEFAULT);
 }
 
 int CanMap::AddSend(Param::PARAM_NUM param, uint32_t canId, uint8_t offsetBits, int8_t length, float gain)
@@ -224,23 +291,90 @@ int CanMap::AddSend(Param::PARAM_NUM param, uint32_t canId, uint8_t offsetBits,
    return AddSend(param, canId, offsetBits, length, gain, 0);
 }
 
-int CanMap::AddRecv(Param::PARAM_NUM param, uint32_t canId, uint8_t offsetBits, int8_t length, float gain, int8_t offset)
+/** \brief Map a received CAN message to a parameter, see AddSend() for the arguments.
+ * The received value is divided by gain, offset is subtracted first.
+ */
+int CanMap::AddRecv(Param::PARAM_NUM param, uint32_t canId, uint8_t offsetBits, int8_t length, float gain, int8_t offset, enum itemtypes type)
 {
    bool forceExtended = (canId & CAN_FORCE_EXTENDED) != 0;
    uint32_t moddedId = canId & ~CAN_FORCE_EXTENDED;
    if (moddedId > MAX_COB_ID) return CAN_ERR_INVALID_ID;
    moddedId |= SHIFT_FORCE_FLAG(forceExtended);
 
-   int res = Add(canRecvMap, param, moddedId, offsetBits, length, gain, offset);
+   int res = Add(canRecvMap, param, moddedId, offsetBits, length, gain, offset, type);
    canHardware->RegisterUserMessage(canId);
    return res;
 }
 
+int CanMap::AddRecv(Param::PARAM_NUM param, uint32_t canId, uint8_t offsetBits, int8_t length, float gain, int8_t offset)
+{
+   return AddRecv(param, canId, offsetBits, length, gain, offset, ITEM_DEFAULT);
+}
+
 int CanMap::AddRecv(Param::PARAM_NUM param, uint32_t canId, uint8_t offsetBits, int8_t length, float gain)
 {
    return AddRecv(param, canId, offsetBits, length, gain, 0);
 }
 
+/** \brief Add all items of a sensor profile table to the receive map
+ *
+ * \param profile table of received values, e.g. of a current shunt
+ * \param count number of entries in profile
+ * \return number of items added or the first error, items before the error stay mapped
+ *
+ */
+int CanMap::AddRecvProfile(const PROFILEITEM* profile, int count)
+{
+   for (int i = 0; i < count; i++)
+   {
+      const PROFILEITEM& item = profile[i];
+      int res = AddRecv(item.param, item.canId, item.offsetBits, item.numBits, item.gain, item.offset, item.type);
+
+      if (res < 0) return res;
+   }
+   return count;
+}
+
+/** \brief Filter a received value before it is scaled and written to its parameter.
+ * The filter stays configured when the map is cleared or reloaded.
+ *
+ * \param param parameter index of the received item
+ * \param cfg filter stages, all values in raw CAN units
+ * \return number of configured filters or CAN_ERR_MAXFILTERS
+ *
+ */
+int CanMap::SetRecvFilter(Param::PARAM_NUM param, const FILTERCFG& cfg)
+{
+   int idx = 0;
+
+   for (; idx < numRxFilters && rxFilters[idx].param != param; idx++);
+
+   if (idx >= MAX_RX_FILTERS) return CAN_ERR_MAXFILTERS;
+
+   RXFILTER* filter = &rxFilters[idx];
+   filter->cfg = cfg;
+   filter->param = param;
+   filter->primed = false;
+
+   if (idx == numRxFilters)
+      numRxFilters++;
+
+   return numRxFilters;
+}
+
+void CanMap::ClearRecvFilter(Param::PARAM_NUM param)
+{
+   for (int i = 0; i < numRxFilters; i++)
+   {
+      if (rxFilters[i].param == param)
+      {
+         numRxFilters--;
+         rxFilters[i] = rxFilters[numRxFilters];
+         return;
+      }
+   }
+}
+
 int CanMap::Remove(Param::PARAM_NUM param)
 {
    bool rx = false;
@@ -401,9 +535,164 @@ void CanMap::ClearMap(CANIDMAP *canMap)
    }
 }
 
-int CanMap::Add(CANIDMAP *canMap, Param::PARAM_NUM param, uint32_t canId, uint8_t offsetBits, int8_t length, float gain, int8_t offset)
+bool CanMap::IsSigned(const CANPOS* pos)
+{
+   return pos->type == ITEM_SIGNED || (pos->type == ITEM_DEFAULT && CAN_SIGNED);
+}
+
+void CanMap::CountOverflow(const CANPOS* pos)
+{
+   uint16_t& count = overflowCount[pos - canPosMap];
+   if (count < 0xFFFF) count++;
+}
+
+void CanMap::StoreRecv(const CANPOS* pos, float val)
 {
-   if (length == 0 || ABS(length) > 32) return CAN_ERR_INVALID_LEN;
+   if (Param::Writable().contains(pos->mapParam))
+      Param::Set((Param::PARAM_NUM)pos->mapParam, FP_FROMFLT(val));
+   else
+      Param::SetFloat((Param::PARAM_NUM)pos->mapParam, val);
+}
+
+/* Fields over 32 bits are handled on the whole frame as one 64-bit word and scaled in double.
+   Big endian bit positions are the same as in the 32-bit path, just counted on the swapped frame.
+   The result is stored in a float parameter, so it is exact only up to 24 significant bits.
+ */
+void CanMap::HandleRxWide(const CANPOS* pos, uint32_t data[2])
+{
+   uint8_t numBits = ABS(pos->numBits);
+   uint64_t word = data[0] | ((uint64_t)data[1] << 32);
+
+   if (pos->numBits < 0)
+      word = __builtin_bswap64(word) >> (63 - pos->offsetBits);
+   else
+      word >>= pos->offsetBits;
+
+   if (numBits < 64) word &= (1ULL << numBits) - 1;
+
+   int64_t raw = word;
+
+   if (IsSigned(pos) && numBits < 64 && (word >> (numBits - 1)) != 0)
+      raw = (int64_t)(word | (~0ULL << numBits));
+
+   if (numRxFilters > 0)
+      raw = ApplyFilter(pos->mapParam, raw);
+
+   double val = IsSigned(pos) ? (double)raw : (double)(uint64_t)raw;
+   val += pos->offset;
+   val *= pos->gain;
+
+   StoreRecv(pos, val);
+}
+
+void CanMap::SendWide(const CANPOS* pos, uint32_t data[2])
+{
+   uint8_t numBits = ABS(pos->numBits);
+   bool isSigned = IsSigned(pos);
+   double val = Param::GetFloat((Param::PARAM_NUM)pos->mapParam);
+
+   val *= pos->gain;
+   val += pos->offset;
+
+   //Powers of 2 are exact in double, so compare against the first value out of range
+   double limit = (double)(1ULL << (numBits - 1 - isSigned)) * 2;
+   double low = isSigned ? -limit : 0;
+   uint64_t word;
+
+   if (val >= limit)
+   {
+      word = (numBits < 64 ? (1ULL << (numBits - isSigned)) : (isSigned ? 1ULL << 63 : 0)) - 1;
+      CountOverflow(pos);
+   }
+   else if (val < low)
+   {
+      word = isSigned ? 0 - (1ULL << (numBits - 1)) : 0;
+      CountOverflow(pos);
+   }
+   else
+   {
+      word = isSigned ? (uint64_t)(int64_t)val : (uint64_t)val;
+   }
+
+   if (numBits < 64) word &= (1ULL << numBits) - 1;
+
+   if (pos->numBits < 0)
+      word = __builtin_bswap64(word << (63 - pos->offsetBits));
+   else
+      word <<= pos->offsetBits;
+
+   data[0] |= (uint32_t)word;
+   data[1] |= (uint32_t)(word >> 32);
+}
+
+int64_t CanMap::ApplyFilter(uint16_t param, int64_t value)
+{
+   RXFILTER* filter = 0;
+
+   for (int i = 0; i < numRxFilters; i++)
+   {
+      if (rxFilters[i].param == param)
+      {
+         filter = &rxFilters[i];
+         break;
+      }
+   }
+
+   if (0 == filter) return value;
+
+   const FILTERCFG& cfg = filter->cfg;
+
+   //Start from the first value instead of ramping up from 0
+   if (!filter->primed)
+   {
+      filter->hist[0] = filter->hist[1] = value;
+      filter->iirState = value * 256;
+      filter->last = value;
+      filter->primed = true;
+   }
+
+   if (cfg.median3)
+   {
+      int64_t in = value;
+      value = MEDIAN3(in, filter->hist[0], filter->hist[1]);
+      filter->hist[1] = filter->hist[0];
+      filter->hist[0] = in;
+   }
+
+   //State has 8 fractional bits so small steps don't get lost by truncation
+   if (cfg.iirShift > 0)
+   {
+      filter->iirState = IIRFILTERF(filter->iirState, value * 256, cfg.iirShift);
+      value = (filter->iirState + (filter->iirState < 0 ? -128 : 128)) / 256;
+   }
+
+   if (cfg.rateLimit > 0)
+   {
+      int64_t last = filter->last;
+      int64_t rate = cfg.rateLimit;
+
+      if (value > last)
+         value = RAMPUP(last, value, rate);
+      else
+         value = RAMPDOWN(last, value, rate);
+   }
+
+   if (cfg.min < cfg.max)
+      value = MIN(MAX(value, (int64_t)cfg.min), (int64_t)cfg.max);
+
+   filter->last = value;
+
+   return value;
+}
+
+int CanMap::Add(CANIDMAP *canMap, Param::PARAM_NUM param, uint32_t canId, uint8_t offsetBits, int8_t length, float gain, int8_t offset, enum itemtypes type)
+{
+   if (param >= Param::PARAM_LAST) return CAN_ERR_INVALID_PARAM;
+   //SetRaw() would bypass the range check and Change() of parameters
+   if (type == ITEM_RAW && Param::Writable().contains(param)) return CAN_ERR_INVALID_PARAM;
+   if (length == 0 || ABS(length) > 64) return CAN_ERR_INVALID_LEN;
+   //Raw values are stored as 32-bit integer
+   if (type == ITEM_RAW && ABS(length) > 32) return CAN_ERR_INVALID_LEN;
    if (length > 0)
    {
       if (offsetBits + length - 1 > 63) return CAN_ERR_INVALID_OFS;
@@ -452,6 +741,8 @@ int CanMap::Add(CANIDMAP *canMap, Param::PARAM_NUM param, uint32_t canId, uint8_
    freeItem->offsetBits = offsetBits;
    freeItem->numBits = length;
    freeItem->next = MAX_ITEMS;
+   freeItem->type = type;
+   overflowCount[freeIndex] = 0;
 
    if (precedingItem == 0)
    {
@@ -500,32 +791,31 @@ void CanMap::ReplaceParamUidByEnum(CANIDMAP *canMap)
       {
          Param::PARAM_NUM param = Param::NumFromId(curPos->mapParam);
          curPos->mapParam = param;
+
+         //Maps saved before item types existed may have garbage in this former padding byte
+         if (curPos->type > ITEM_RAW)
+            curPos->type = ITEM_DEFAULT;
       }
    }
 }
 
 void CanMap::Save()
 {
-   struct MapStorage
-   {
-      CANIDMAP sendMap[MAX_MESSAGES];
-      CANIDMAP recvMap[MAX_MESSAGES];
-      CANPOS posMap[MAX_ITEMS + 1];
-      uint32_t crc;
-   };
-
    isSaving = true;
 
    ReplaceParamEnumByUid(canSendMap);
    ReplaceParamEnumByUid(canRecvMap);
 
+#ifdef E2END
+   static_assert(CANMAP_EEPROM_BASE + sizeof(MapStorage) <= E2END + 1, "CAN map does not fit in EEPROM, reduce PARAM_MAX_PAGES or MAX_ITEMS");
+#endif
    MapStorage storage;
    memcpy(&storage.sendMap, canSendMap, sizeof(canSendMap));
    memcpy(&storage.recvMap, canRecvMap, sizeof(canRecvMap));
    memcpy(&storage.posMap, canPosMap, sizeof(canPosMap));
 
    const uint32_t words = (sizeof(storage) - sizeof(uint32_t)) / sizeof(uint32_t);
-   storage.crc = calculate_crc32_block((uint32_t*)&storage, words);
+   storage.crc = crc32_block((uint32_t*)&storage, words);
    EEPROM.put(kCanMapEepromBase, storage);
 
    ReplaceParamUidByEnum(canSendMap);
@@ -534,33 +824,67 @@ void CanMap::Save()
    isSaving = false;
 }
 
-int CanMap::LoadFromFlash()
+/** \brief Start loading the CAN map from flash in chunks
+ * The current map is replaced. Until LoadChunk() has returned false no mapped
+ * messages are sent or received and the map must not be modified.
+ */
+void CanMap::StartLoad()
+{
+   isLoading = true;
+   loadOffset = 0;
+   loadCrc = CRC32_INIT;
+}
+
+/** \brief Load the next CANMAP_LOAD_CHUNK bytes of the CAN map from flash
+ * Call this from the main loop after StartLoad() to spread the load over several iterations
+ * \return true while loading is still in progress
+ */
+bool CanMap::LoadChunk()
 {
-   struct MapStorage
+   static_assert(offsetof(MapStorage, recvMap) == sizeof(canSendMap), "Map storage must be contiguous");
+   static_assert(offsetof(MapStorage, posMap) == sizeof(canSendMap) + sizeof(canRecvMap), "Map storage must be contiguous");
+   const uint16_t crcOffset = offsetof(MapStorage, crc);
+
+   if (!isLoading) return false;
+
+   uint16_t end = MIN(loadOffset + CANMAP_LOAD_CHUNK, crcOffset);
+
+   for (; loadOffset < end; loadOffset += sizeof(uint32_t))
    {
-      CANIDMAP sendMap[MAX_MESSAGES];
-      CANIDMAP recvMap[MAX_MESSAGES];
-      CANPOS posMap[MAX_ITEMS + 1];
-      uint32_t crc;
-   };
+      uint32_t word;
+      EEPROM.get(kCanMapEepromBase + loadOffset, word);
+      loadCrc = crc32_word(loadCrc, word);
+      memcpy(LoadTarget(loadOffset), &word, sizeof(word));
+   }
 
-   MapStorage storage;
-   EEPROM.get(kCanMapEepromBase, storage);
+   if (loadOffset < crcOffset) return true;
 
-   const uint32_t words = (sizeof(storage) - sizeof(uint32_t)) / sizeof(uint32_t);
-   const uint32_t crc = calculate_crc32_block((uint32_t*)&storage, words);
+   uint32_t crc;
+   EEPROM.get(kCanMapEepromBase + crcOffset, crc);
 
-   if (storage.crc == crc)
+   if (crc == ~loadCrc)
    {
-      memcpy(canSendMap, storage.sendMap, sizeof(canSendMap));
-      memcpy(canRecvMap, storage.recvMap, sizeof(canRecvMap));
-      memcpy(canPosMap, storage.posMap, sizeof(canPosMap));
       ReplaceParamUidByEnum(canSendMap);
       ReplaceParamUidByEnum(canRecvMap);
-      return 1;
    }
+   else
+   {
+      ClearMap(canSendMap);
+      ClearMap(canRecvMap);
+      LegacyLoadFromFlash();
+   }
+
+   isLoading = false;
+   HandleClear();
+   return false;
+}
+
+int CanMap::LoadFromFlash()
+{
+   StartLoad();
+   while (LoadChunk());
 
-   return LegacyLoadFromFlash();
+   return canSendMap[0].first != MAX_ITEMS || canRecvMap[0].first != MAX_ITEMS;
 }
 
 int CanMap::LegacyLoadFromFlash()
@@ -568,3 +892,16 @@ int CanMap::LegacyLoadFromFlash()
    // Simplified - just return failure for now
    return 0;
 }
+
+uint8_t* CanMap::LoadTarget(uint16_t offset)
+{
+   if (offset < sizeof(canSendMap))
+      return (uint8_t*)canSendMap + offset;
+   offset -= sizeof(canSendMap);
+
+   if (offset < sizeof(canRecvMap))
+      return (uint8_t*)canRecvMap + offset;
+   offset -= sizeof(canRecvMap);
+
+   return (uint8_t*)canPosMap + offset;
+}
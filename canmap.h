@@ -20,14 +20,22 @@
 #define CANMAP_H
 #include "params.h"
 #include "canhardware.h"
+#include "param_save.h"
 
 #define CAN_ERR_INVALID_ID -1
 #define CAN_ERR_INVALID_OFS -2
 #define CAN_ERR_INVALID_LEN -3
 #define CAN_ERR_MAXMESSAGES -4
 #define CAN_ERR_MAXITEMS -5
+#define CAN_ERR_MAXFILTERS -6
+#define CAN_ERR_INVALID_PARAM -7
 #define CAN_FORCE_EXTENDED 0x20000000
 
+//CAN map is stored right after the parameter pages
+#ifndef CANMAP_EEPROM_BASE
+#define CANMAP_EEPROM_BASE (PARAM_EEPROM_BASE + PARAM_MAX_PAGES * PARAM_PAGE_SIZE)
+#endif
+
 #ifndef MAX_ITEMS
 #define MAX_ITEMS 50
 #endif
@@ -36,6 +44,16 @@
 #define MAX_MESSAGES 10
 #endif
 
+//Number of bytes read from flash per LoadChunk() call
+#ifndef CANMAP_LOAD_CHUNK
+#define CANMAP_LOAD_CHUNK 64
+#endif
+
+//Number of received items that can have a filter, see SetRecvFilter()
+#ifndef MAX_RX_FILTERS
+#define MAX_RX_FILTERS 8
+#endif
+
 #ifndef CAN_SIGNED
 #define CAN_SIGNED 0
 #endif // CAN_SIGNED
@@ -49,6 +67,17 @@
 class CanMap: CanCallback
 {
    public:
+      /** \brief How a mapped value is converted. ITEM_DEFAULT follows CAN_SIGNED,
+       * ITEM_RAW passes up to 32 bits unsigned to Param::SetRaw()/GetRaw() without gain and offset
+       */
+      enum itemtypes
+      {
+         ITEM_DEFAULT,
+         ITEM_UNSIGNED,
+         ITEM_SIGNED,
+         ITEM_RAW
+      };
+
       struct CANPOS
       {
          float gain;
@@ -57,6 +86,31 @@ class CanMap: CanCallback
          uint8_t offsetBits;
          int8_t numBits;
          uint8_t next;
+         uint8_t type; //itemtypes, uses what was padding before so the stored map keeps its layout
+      };
+
+      /** \brief One received value of a sensor profile, see AddRecvProfile() */
+      struct PROFILEITEM
+      {
+         uint32_t canId;
+         Param::PARAM_NUM param;
+         uint8_t offsetBits;
+         int8_t numBits;
+         float gain;
+         int8_t offset;
+         enum itemtypes type;
+      };
+
+      /** \brief Post-processing of a received value, applied to the raw CAN value before offset and gain.
+       * Stages run in the order median of 3, IIR low-pass, rate limit, clamp.
+       */
+      struct FILTERCFG
+      {
+         bool median3;      //Median of the last 3 values, removes single spikes
+         uint8_t iirShift;  //IIR constant c as in IIRFILTER(), 0: off
+         int32_t rateLimit; //Maximum change per frame in raw units, 0: off
+         int32_t min;       //Clamp to [min, max] in raw units, off if min >= max
+         int32_t max;
       };
 
       explicit CanMap(CanHardware* hw, bool loadFromFlash = true);
@@ -65,15 +119,26 @@ class CanMap: CanCallback
       void HandleRx(uint32_t canId, uint32_t data[2], uint8_t dlc) override;
       void Clear();
       void SendAll();
+      void EnableSend(bool enable) { sendEnabled = enable; }
       int AddSend(Param::PARAM_NUM param, uint32_t canId, uint8_t offsetBits, int8_t length, float gain);
       int AddRecv(Param::PARAM_NUM param, uint32_t canId, uint8_t offsetBits, int8_t length, float gain);
       int AddSend(Param::PARAM_NUM param, uint32_t canId, uint8_t offsetBits, int8_t length, float gain, int8_t offset);
       int AddRecv(Param::PARAM_NUM param, uint32_t canId, uint8_t offsetBits, int8_t length, float gain, int8_t offset);
+      int AddSend(Param::PARAM_NUM param, uint32_t canId, uint8_t offsetBits, int8_t length, float gain, int8_t offset, enum itemtypes type);
+      int AddRecv(Param::PARAM_NUM param, uint32_t canId, uint8_t offsetBits, int8_t length, float gain, int8_t offset, enum itemtypes type);
+      int AddRecvProfile(const PROFILEITEM* profile, int count);
       int Remove(Param::PARAM_NUM param);
+      int SetRecvFilter(Param::PARAM_NUM param, const FILTERCFG& cfg);
+      void ClearRecvFilter(Param::PARAM_NUM param);
       int Remove(bool rx, uint8_t ididx, uint8_t itemidx);
       void Save();
+      void StartLoad();
+      bool LoadChunk();
+      bool IsLoading() { return isLoading; }
       bool FindMap(Param::PARAM_NUM param, uint32_t& canId, uint8_t& start, int8_t& length, float& gain, int8_t& offset, bool& rx);
       const CANPOS* GetMap(bool rx, uint8_t ididx, uint8_t itemidx, uint32_t& canId);
+      uint16_t GetOverflowCount(const CANPOS* pos) { return overflowCount[pos - canPosMap]; }
+      void ResetOverflowCount(const CANPOS* pos) { overflowCount[pos - canPosMap] = 0; }
       void IterateCanMap(void (*callback)(Param::PARAM_NUM, uint32_t, uint8_t, int8_t, float, int8_t, bool));
 
    protected:
@@ -91,14 +156,46 @@ class CanMap: CanCallback
          uint8_t first;
       };
 
+      struct RXFILTER
+      {
+         FILTERCFG cfg;
+         int64_t hist[2];   //Last two input values for the median
+         int64_t iirState;  //Q8 fixed point
+         int64_t last;      //Last output for the rate limiter
+         uint16_t param;
+         bool primed;       //State has been initialized from the first value
+      };
+
+      struct MapStorage
+      {
+         CANIDMAP sendMap[MAX_MESSAGES];
+         CANIDMAP recvMap[MAX_MESSAGES];
+         CANPOS posMap[MAX_ITEMS + 1];
+         uint32_t crc;
+      };
+
       CanHardware* canHardware;
+      bool sendEnabled;
+      bool isLoading;
+      uint16_t loadOffset;
+      uint32_t loadCrc;
       CANIDMAP canSendMap[MAX_MESSAGES];
       CANIDMAP canRecvMap[MAX_MESSAGES];
       CANPOS canPosMap[MAX_ITEMS + 1]; //Last item is a "tail"
+      uint16_t overflowCount[MAX_ITEMS + 1]; //Number of saturated sends per item
+      RXFILTER rxFilters[MAX_RX_FILTERS];
+      uint8_t numRxFilters;
 
       void ClearMap(CANIDMAP *canMap);
-      int Add(CANIDMAP *canMap, Param::PARAM_NUM param, uint32_t canId, uint8_t offsetBits, int8_t length, float gain, int8_t offset);
+      int64_t ApplyFilter(uint16_t param, int64_t value);
+      static bool IsSigned(const CANPOS* pos);
+      void CountOverflow(const CANPOS* pos);
+      void StoreRecv(const CANPOS* pos, float val);
+      void HandleRxWide(const CANPOS* pos, uint32_t data[2]); //Exact up to 24 bits, the parameters are float
+      void SendWide(const CANPOS* pos, uint32_t data[2]);
+      int Add(CANIDMAP *canMap, Param::PARAM_NUM param, uint32_t canId, uint8_t offsetBits, int8_t length, float gain, int8_t offset, enum itemtypes type);
       int LoadFromFlash();
+      uint8_t* LoadTarget(uint16_t offset);
       int LegacyLoadFromFlash();
       CANIDMAP *FindById(CANIDMAP *canMap, uint32_t canId);
       int CopyIdMapExcept(CANIDMAP *source, CANIDMAP *dest, Param::PARAM_NUM param);
@@ -0,0 +1,223 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "cannmt.h"
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+#define NODE_WORD(id)   ((id) >> 5)
+#define NODE_BIT(id)    (1UL << ((id) & 31))
+
+/** \brief NMT slave and heartbeat producer/consumer
+ *
+ * \param hw CanHardware*
+ * \param cm CanMap* whose SendAll() is only active in operational state
+ * \param autoStart go to operational after boot-up instead of waiting for an NMT start command
+ *
+ */
+CanNmt::CanNmt(CanHardware* hw, CanMap* cm, bool autoStart)
+ : canHardware(hw), canMap(cm), nodeId(1), autoStart(autoStart), state(BootUp),
+   heartbeatPeriod(0), lastHeartbeat(0), nodeCallback(0)
+{
+   for (int i = 0; i < NMT_MAX_NODES / 32; i++)
+   {
+      consumerMask[i] = 0;
+      aliveMask[i] = 0;
+   }
+
+   for (int i = 0; i < NMT_MAX_NODES; i++)
+   {
+      lastSeen[i] = 0;
+      consumerTimeout[i] = 0;
+      nodeState[i] = BootUp;
+   }
+
+   HandleClear();
+}
+
+//Somebody (perhaps us) has cleared all user messages. Register them again
+void CanNmt::HandleClear()
+{
+   canHardware->RegisterUserMessage(NMT_COB_ID);
+   canHardware->RegisterUserMessage(NMT_HEARTBEAT_ID_BASE, NMT_HEARTBEAT_ID_MASK);
+}
+
+void CanNmt::HandleRx(uint32_t canId, uint32_t data[2], uint8_t dlc)
+{
+   const uint8_t* bytes = (uint8_t*)data;
+
+   if (canId == NMT_COB_ID)
+   {
+      if (dlc >= 2 && (bytes[1] == 0 || bytes[1] == nodeId))
+         ProcessCommand(bytes[0]);
+   }
+   else if ((canId & ~0x7FU) == NMT_HEARTBEAT_ID_BASE && canId != NMT_HEARTBEAT_ID_BASE && dlc > 0)
+   {
+      uint8_t id = canId & 0x7F;
+
+      lastSeen[id] = (uint16_t)canHardware->GetLastRxTimestamp();
+      nodeState[id] = bytes[0] & 0x7F;
+
+      if ((aliveMask[NODE_WORD(id)] & NODE_BIT(id)) == 0)
+      {
+         aliveMask[NODE_WORD(id)] |= NODE_BIT(id);
+         if (nodeCallback) nodeCallback(id, true);
+      }
+   }
+}
+
+void CanNmt::SetNodeId(uint8_t id)
+{
+   nodeId = id;
+}
+
+void CanNmt::SetState(enum states newState)
+{
+   state = newState;
+
+   if (canMap != 0)
+      canMap->EnableSend(state == Operational);
+}
+
+/** \brief Send an NMT command as master
+ *
+ * \param command one of the NMT_CMD_xx codes
+ * \param targetNodeId node to address, 0 for all nodes
+ *
+ */
+void CanNmt::SendCommand(uint8_t command, uint8_t targetNodeId)
+{
+   uint8_t bytes[8] = { command, targetNodeId };
+
+   canHardware->Send(NMT_COB_ID, bytes, 2);
+
+   //Broadcasts and commands to our own id apply to us as well
+   if (targetNodeId == 0 || targetNodeId == nodeId)
+      ProcessCommand(command);
+}
+
+/** \brief Monitor the heartbeat of a remote node
+ *
+ * \param remoteNodeId node id 1..127
+ * \param timeout time in ms after which the node is considered lost
+ * \return true: success, false: invalid node id
+ *
+ */
+bool CanNmt::AddConsumer(uint8_t remoteNodeId, uint16_t timeout)
+{
+   if (remoteNodeId == 0 || remoteNodeId >= NMT_MAX_NODES) return false;
+
+   consumerTimeout[remoteNodeId] = timeout;
+   consumerMask[NODE_WORD(remoteNodeId)] |= NODE_BIT(remoteNodeId);
+   return true;
+}
+
+void CanNmt::RemoveConsumer(uint8_t remoteNodeId)
+{
+   if (remoteNodeId >= NMT_MAX_NODES) return;
+
+   consumerMask[NODE_WORD(remoteNodeId)] &= ~NODE_BIT(remoteNodeId);
+}
+
+bool CanNmt::IsNodeAlive(uint8_t remoteNodeId)
+{
+   if (remoteNodeId >= NMT_MAX_NODES) return false;
+
+   return (aliveMask[NODE_WORD(remoteNodeId)] & NODE_BIT(remoteNodeId)) != 0;
+}
+
+enum CanNmt::states CanNmt::GetNodeState(uint8_t remoteNodeId)
+{
+   if (!IsNodeAlive(remoteNodeId)) return BootUp;
+
+   return (enum states)nodeState[remoteNodeId];
+}
+
+/** \brief Send boot-up and heartbeat messages and check consumer timeouts
+ *
+ * \param time current time in ms, e.g. millis()
+ * \return void
+ *
+ */
+void CanNmt::Task(uint32_t time)
+{
+   if (state == BootUp)
+   {
+      SendHeartbeat(); //boot-up message
+      lastHeartbeat = time;
+      SetState(autoStart ? Operational : PreOperational);
+   }
+   else if (heartbeatPeriod > 0 && (time - lastHeartbeat) >= heartbeatPeriod)
+   {
+      SendHeartbeat();
+      lastHeartbeat = time;
+   }
+
+   for (int word = 0; word < NMT_MAX_NODES / 32; word++)
+   {
+      uint32_t pending = consumerMask[word] & aliveMask[word];
+
+      while (pending != 0)
+      {
+         int bit = __builtin_ctz(pending);
+         uint8_t id = word * 32 + bit;
+         pending &= pending - 1;
+
+         if ((uint16_t)(time - lastSeen[id]) > consumerTimeout[id])
+         {
+            aliveMask[word] &= ~(1UL << bit);
+            if (nodeCallback) nodeCallback(id, false);
+         }
+      }
+   }
+}
+
+/****************** Private methods ********************/
+
+void CanNmt::ProcessCommand(uint8_t command)
+{
+   switch (command)
+   {
+   case NMT_CMD_START:
+      SetState(Operational);
+      break;
+   case NMT_CMD_STOP:
+      SetState(Stopped);
+      break;
+   case NMT_CMD_PREOPERATIONAL:
+      SetState(PreOperational);
+      break;
+   case NMT_CMD_RESET_NODE:
+#ifdef ARDUINO
+      NVIC_SystemReset();
+#endif
+      SetState(BootUp);
+      break;
+   case NMT_CMD_RESET_COMM:
+      SetState(BootUp); //Boot-up message is sent on next Task() call
+      break;
+   }
+}
+
+void CanNmt::SendHeartbeat()
+{
+   uint8_t bytes[8] = { (uint8_t)state };
+
+   canHardware->Send(NMT_HEARTBEAT_ID_BASE + nodeId, bytes, 1);
+}
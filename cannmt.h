@@ -0,0 +1,83 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CANNMT_H
+#define CANNMT_H
+#include "canhardware.h"
+#include "canmap.h"
+
+#define NMT_COB_ID              0x000U
+#define NMT_HEARTBEAT_ID_BASE   0x700U
+#define NMT_HEARTBEAT_ID_MASK   0x780U
+
+#define NMT_CMD_START           0x01
+#define NMT_CMD_STOP            0x02
+#define NMT_CMD_PREOPERATIONAL  0x80
+#define NMT_CMD_RESET_NODE      0x81
+#define NMT_CMD_RESET_COMM      0x82
+
+#define NMT_MAX_NODES           128
+
+class CanNmt: CanCallback
+{
+   public:
+      enum states
+      {
+         BootUp = 0x00,
+         Stopped = 0x04,
+         Operational = 0x05,
+         PreOperational = 0x7F
+      };
+
+      explicit CanNmt(CanHardware* hw, CanMap* cm = 0, bool autoStart = true);
+      void HandleClear() override;
+      void HandleRx(uint32_t canId, uint32_t data[2], uint8_t dlc) override;
+      void SetNodeId(uint8_t id);
+      void SetState(enum states newState);
+      enum states GetState() { return state; }
+      void SendCommand(uint8_t command, uint8_t targetNodeId);
+      void SetHeartbeatPeriod(uint16_t period) { heartbeatPeriod = period; }
+      bool AddConsumer(uint8_t remoteNodeId, uint16_t timeout);
+      void RemoveConsumer(uint8_t remoteNodeId);
+      bool IsNodeAlive(uint8_t remoteNodeId);
+      enum states GetNodeState(uint8_t remoteNodeId);
+      void SetNodeCallback(void (*callback)(uint8_t, bool)) { nodeCallback = callback; }
+      void Task(uint32_t time);
+
+   private:
+      CanHardware* canHardware;
+      CanMap* canMap;
+      uint8_t nodeId;
+      bool autoStart;
+      enum states state;
+      uint16_t heartbeatPeriod;
+      uint32_t lastHeartbeat;
+      //Heartbeat consumer. One bit per node id, so a timeout scan only
+      //visits NMT_MAX_NODES / 32 words plus the nodes that are alive
+      uint32_t consumerMask[NMT_MAX_NODES / 32];
+      uint32_t aliveMask[NMT_MAX_NODES / 32];
+      uint16_t lastSeen[NMT_MAX_NODES];
+      uint16_t consumerTimeout[NMT_MAX_NODES];
+      uint8_t nodeState[NMT_MAX_NODES];
+      void (*nodeCallback)(uint8_t, bool);
+
+      void ProcessCommand(uint8_t command);
+      void SendHeartbeat();
+};
+
+#endif // CANNMT_H
@@ -17,32 +17,11 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "cansdo.h"
-#include "my_math.h"
-#include "errormessage.h"
-#include "param_save.h"
-#ifdef ARDUINO
-#include <Arduino.h>
-#endif
+#include <string.h>
 
 #define SDO_REQ_ID_BASE       0x600U
 #define SDO_REP_ID_BASE       0x580U
-
-#define SDO_INDEX_PARAMS      0x2000
-#define SDO_INDEX_PARAM_UID   0x2100
-#define SDO_INDEX_MAP_TX      0x3000
-#define SDO_INDEX_MAP_RX      0x3001
-#define SDO_INDEX_MAP_RD      0x3100
-#define SDO_INDEX_SERIAL      0x5000
-#define SDO_INDEX_STRINGS     0x5001
-#define SDO_INDEX_COMMAND     0x5002
-#define SDO_INDEX_ERROR_NUM   0x5003
-#define SDO_INDEX_ERROR_TIME  0x5004
-
-
-#define PRINT_BUF_ENQUEUE(c)  printBuffer[(printByteIn++) & (sizeof(printBuffer) - 1)] = c
-#define PRINT_BUF_DEQUEUE()   printBuffer[(printByteOut++) & (sizeof(printBuffer) - 1)]
-#define PRINT_BUF_EMPTY()     ((printByteOut - printByteIn) == sizeof(printBuffer))
-#define PRINT_TIMEOUT         1000
+#define SDO_REP_ID_MASK       0x780U
 
 /** \brief
  *
@@ -51,11 +30,8 @@
  *
  */
  CanSdo::CanSdo(CanHardware* hw, CanMap* cm)
- : canHardware(hw), canMap(cm), nodeId(1), remoteNodeId(255), printRequest(-1),
-   printByteIn(0), printByteOut(sizeof(printBuffer)), printTimeout(PRINT_TIMEOUT),
-   mapParam(Param::PARAM_INVALID), mapId(0), sdoReplyValid(false), sdoReplyData(0),
-   pendingUserSpaceSdo(false), jsonSize(0), printCallback(nullptr), 
-   jsonStreamActive(false)
+ : SdoServer(cm), canHardware(hw), nodeId(1), remoteNodeId(255), sdoReplyValid(false), sdoReplyData(0),
+   remoteMapping(false), numClients(0)
 {
    HandleClear();
 }
@@ -65,7 +41,9 @@ void CanSdo::HandleClear()
 {
    canHardware->RegisterUserMessage(SDO_REQ_ID_BASE + nodeId);
 
-   if (remoteNodeId < 64)
+   if (numClients > 0)
+      canHardware->RegisterUserMessage(SDO_REP_ID_BASE, SDO_REP_ID_MASK);
+   else if (remoteNodeId < 64)
       canHardware->RegisterUserMessage(SDO_REP_ID_BASE + remoteNodeId);
 }
 
@@ -75,15 +53,24 @@ void CanSdo::HandleRx(uint32_t canId, uint32_t data[2], uint8_t)
    {
       ProcessSDO(data);
    }
-   else if (canId == (SDO_REP_ID_BASE + remoteNodeId))
+   else if ((canId & ~0x7FU) == SDO_REP_ID_BASE && canId != SDO_REP_ID_BASE)
    {
       SdoFrame* sdoFrame = (SdoFrame*)data;
-      if (sdoFrame->index == SDO_INDEX_MAP_RX || sdoFrame->index == SDO_INDEX_MAP_TX)
+
+      for (int i = 0; i < numClients; i++)
+         clients[i]->HandleSdoReply(canId & 0x7F, sdoFrame);
+
+      if (canId != (SDO_REP_ID_BASE + remoteNodeId)) return;
+
+      //Continue the transfer started by RemoteMap()
+      if (remoteMapping && (sdoFrame->index == SDO_INDEX_MAP_RX || sdoFrame->index == SDO_INDEX_MAP_TX))
       {
-         if (sdoFrame->subIndex == 0)
-            InitiateSDOTransfer(SDO_WRITE, remoteNodeId, sdoFrame->index, 1, mapInfo.mapParam | (mapInfo.offsetBits << 16) | (mapInfo.numBits << 24));
+         if (sdoFrame->cmd == SDO_ABORT || sdoFrame->subIndex == 2)
+            remoteMapping = false;
+         else if (sdoFrame->subIndex == 0)
+            InitiateSDOTransfer(SDO_WRITE, remoteNodeId, sdoFrame->index, 1, remoteMapInfo.mapParam | (remoteMapInfo.offsetBits << 16) | (remoteMapInfo.type << 22) | (remoteMapInfo.numBits << 24));
          else if (sdoFrame->subIndex == 1)
-            InitiateSDOTransfer(SDO_WRITE, remoteNodeId, sdoFrame->index, 2, (int32_t)(mapInfo.gain * 1000.0f) | (mapInfo.offset << 24));
+            InitiateSDOTransfer(SDO_WRITE, remoteNodeId, sdoFrame->index, 2, (int32_t)(remoteMapInfo.gain * 1000.0f) | (remoteMapInfo.offset << 24));
       }
       sdoReplyValid = sdoFrame->cmd != SDO_ABORT;
       sdoReplyData = sdoFrame->data;
@@ -109,11 +96,42 @@ bool CanSdo::SDOReadReply(uint32_t& data)
 
 void CanSdo::RemoteMap(uint8_t nodeId, bool rx, uint32_t cobId, CanMap::CANPOS mapping)
 {
-   mapInfo = mapping;
+   remoteMapInfo = mapping;
+   remoteMapping = true;
 
    InitiateSDOTransfer(SDO_WRITE, nodeId, rx ? SDO_INDEX_MAP_RX : SDO_INDEX_MAP_TX, 0, cobId);
 }
 
+/** \brief Pass the SDO replies of all remote nodes to client
+ *
+ * \param client receiver of the replies, e.g. RemoteMapper
+ * \return false when SDO_MAX_CLIENTS are already added
+ *
+ */
+bool CanSdo::AddClient(ISdoClient* client)
+{
+   if (numClients >= SDO_MAX_CLIENTS) return false;
+
+   clients[numClients++] = client;
+   //This registers the reply messages of all nodes
+   canHardware->ClearUserMessages();
+   return true;
+}
+
+/** \brief Send any request to a remote node, the reply goes to the clients
+ *
+ * \param nodeId remote node id
+ * \param request request frame
+ *
+ */
+void CanSdo::SDORequest(uint8_t nodeId, const SdoFrame* request)
+{
+   uint32_t data[2];
+
+   memcpy(data, request, sizeof(data));
+   canHardware->Send(SDO_REQ_ID_BASE + nodeId, data);
+}
+
 void CanSdo::SetNodeId(uint8_t id)
 {
    nodeId = id;
@@ -141,390 +159,60 @@ void CanSdo::InitiateSDOTransfer(uint8_t req, uint8_t nodeId, uint16_t index, ui
    canHardware->Send(SDO_REQ_ID_BASE + remoteNodeId, d);
 }
 
-//http://www.byteme.org.uk/canopenparent/canopen/sdo-service-data-objects-canopen/
 void CanSdo::ProcessSDO(uint32_t data[2])
 {
-   SdoFrame *sdo = (SdoFrame*)data;
-
-   if ((sdo->cmd & SDO_REQUEST_SEGMENT) == SDO_REQUEST_SEGMENT)
-   {
-      const int bytesPerMessage = 7;
-      uint8_t *bytes = (uint8_t*)data;
-      int i = 1;
-
-      sdo->cmd = sdo->cmd & SDO_TOGGLE_BIT;
+   if (ProcessRequest((SdoFrame*)data, this))
+      canHardware->Send(SDO_REP_ID_BASE + nodeId, data);
 
-      // Use ParamJson streaming source for JSON transfer
-      if (jsonStreamActive)
-      {
-         size_t count = ParamJson::Read(&bytes[1], bytesPerMessage);
-         if (count < (size_t)bytesPerMessage)
-         {
-            for (size_t j = count; j < (size_t)bytesPerMessage; j++)
-            {
-               bytes[1 + j] = 0;
-            }
-            sdo->cmd |= SDO_SIZE_SPECIFIED;
-            sdo->cmd |= (bytesPerMessage - (int)count) << 1;
-            printRequest = -1;
-            jsonStreamActive = false;
-         }
-      }
-      // Otherwise use legacy buffer-based approach
-      else
-      {
-         // If buffer is low and we have a print callback, refill it
-         uint32_t bufferUsed = sizeof(printBuffer) - (printByteOut - printByteIn);
-         
-         #ifdef ARDUINO
-         Serial.printf("SEG REQ: bufUsed=%lu printReq=%d callback=%p in=%lu out=%lu\r\n", 
-                       bufferUsed, printRequest, printCallback, printByteIn, printByteOut);
-         #endif
-         
-         if (printRequest >= 0 && bufferUsed < 32 && printCallback != nullptr)
-         {
-            #ifdef ARDUINO
-            Serial.println("Calling printCallback to refill buffer");
-            #endif
-            printCallback();  // Refill buffer on-demand
-         }
-
-         for (; i <= bytesPerMessage && !PRINT_BUF_EMPTY(); i++)
-            bytes[i] = PRINT_BUF_DEQUEUE();
-
-         if (PRINT_BUF_EMPTY())
-         {
-            sdo->cmd |= SDO_SIZE_SPECIFIED;
-            sdo->cmd |= (bytesPerMessage - i + 1) << 1;
-         }
-      }
-   }
-   else if (sdo->index == SDO_INDEX_PARAMS || (sdo->index & 0xFF00) == SDO_INDEX_PARAM_UID)
-   {
-      Param::PARAM_NUM paramIdx = (Param::PARAM_NUM)sdo->subIndex;
+   RebootIfRequested();
+}
 
-      //SDO index 0x21xx will look up the parameter by its unique ID
-      //using subIndex as low byte and xx as high byte of ID
-      if ((sdo->index & 0xFF00) == SDO_INDEX_PARAM_UID)
-         paramIdx = Param::NumFromId(sdo->subIndex + ((sdo->index & 0xFF) << 8));
+void CanSdo::SendReply(const SdoFrame* reply)
+{
+   uint32_t data[2];
 
-      if (paramIdx < Param::PARAM_LAST)
-      {
-         if (sdo->cmd == SDO_WRITE)
-         {
-            #ifdef ARDUINO
-            const Param::Attributes* attr = Param::GetAttrib(paramIdx);
-            Serial.printf("CAN SDO: Writing param '%s' = %d (0x%08X)\r\n",
-                         attr ? attr->name : "unknown", sdo->data, sdo->data);
-            #endif
-            if (Param::Set(paramIdx, sdo->data) == 0)
-            {
-               sdo->cmd = SDO_WRITE_REPLY;
-            }
-            else
-            {
-               #ifdef ARDUINO
-               Serial.println("CAN SDO: Parameter write failed (out of range)");
-               #endif
-               sdo->cmd = SDO_ABORT;
-               sdo->data = SDO_ERR_RANGE;
-            }
-         }
-         else if (sdo->cmd == SDO_READ)
-         {
-            sdo->data = Param::Get(paramIdx);
-            sdo->cmd = SDO_READ_REPLY;
-         }
-      }
-      else
-      {
-         sdo->cmd = SDO_ABORT;
-         sdo->data = SDO_ERR_INVIDX;
-      }
-   }
-   else if (0 != canMap && sdo->index == SDO_INDEX_MAP_TX)
-   {
-      AddCanMap(sdo, false);
-   }
-   else if (0 != canMap && sdo->index == SDO_INDEX_MAP_RX)
-   {
-      AddCanMap(sdo, true);
-   }
-   else if (0 != canMap && (sdo->index & 0xFF00) == SDO_INDEX_MAP_RD)
-   {
-      ReadOrDeleteCanMap(sdo);
-   }
-   else if (sdo->index == SDO_INDEX_SERIAL)
-   {
-      if (sdo->cmd == SDO_READ && sdo->subIndex <= 3)
-      {
-         sdo->data = Param::Get(Param::serial) + sdo->subIndex;
-         sdo->cmd = SDO_READ_REPLY;
-      }
-      else
-      {
-         sdo->cmd = SDO_ABORT;
-         sdo->data = SDO_ERR_INVIDX;
-      }
-   }
-   else if (sdo->index == SDO_INDEX_COMMAND)
-   {
-      if (sdo->cmd == SDO_WRITE)
-      {
-         if (sdo->subIndex == 0)
-         {
-            // Save parameters to flash
-            #ifdef ARDUINO
-            Serial.println("CAN SDO: Received save command, saving parameters to flash...");
-            #endif
-            parm_save();
-            sdo->cmd = SDO_WRITE_REPLY;
-         }
-         else if (sdo->subIndex == 1)
-         {
-            // Save CAN mappings to flash
-            #ifdef ARDUINO
-            Serial.println("CAN SDO: Received save CAN maps command...");
-            #endif
-            if (canMap != nullptr)
-            {
-               canMap->Save();
-               #ifdef ARDUINO
-               Serial.println("CAN SDO: CAN maps saved successfully");
-               #endif
-               sdo->cmd = SDO_WRITE_REPLY;
-            }
-            else
-            {
-               #ifdef ARDUINO
-               Serial.println("CAN SDO: Error - CAN map not initialized");
-               #endif
-               sdo->cmd = SDO_ABORT;
-               sdo->data = SDO_ERR_GENERAL;
-            }
-         }
-         else if (sdo->subIndex == 2)
-         {
-            // Reset/reboot command
-            sdo->cmd = SDO_WRITE_REPLY;
-            // Send reply first, then reboot after a short delay
-            canHardware->Send(0x580 + nodeId, data);
-            // Trigger system reset (platform-specific)
-            #ifdef ARDUINO
-            NVIC_SystemReset();
-            #endif
-            return; // Don't send reply again
-         }
-         else
-         {
-            #ifdef ARDUINO
-            Serial.printf("CAN SDO: Invalid save command (subIndex=%d, data=%d)\r\n", sdo->subIndex, sdo->data);
-            #endif
-            sdo->cmd = SDO_ABORT;
-            sdo->data = SDO_ERR_INVIDX;
-         }
-      }
-      else
-      {
-         sdo->cmd = SDO_ABORT;
-         sdo->data = SDO_ERR_INVIDX;
-      }
-   }
-   else if (sdo->index == SDO_INDEX_ERROR_NUM)
-   {
-      if (sdo->cmd == SDO_READ)
-      {
-         sdo->data = ErrorMessage::GetErrorNum(sdo->subIndex);
-         sdo->cmd = SDO_READ_REPLY;
-      }
-      else
-      {
-         sdo->cmd = SDO_ABORT;
-         sdo->data = SDO_ERR_INVIDX;
-      }
-   }
-   else if (sdo->index == SDO_INDEX_ERROR_TIME)
-   {
-      if (sdo->cmd == SDO_READ)
-      {
-         sdo->data = ErrorMessage::GetErrorTime(sdo->subIndex);
-         sdo->cmd = SDO_READ_REPLY;
-      }
-      else
-      {
-         sdo->cmd = SDO_ABORT;
-         sdo->data = SDO_ERR_INVIDX;
-      }
-   }
-   else
-   {
-      if (!ProcessSpecialSDOObjects(sdo))
-         return; //Don't send reply when handled by user space
-   }
-   canHardware->Send(0x580 + nodeId, data);
+   memcpy(data, reply, sizeof(data));
+   canHardware->Send(SDO_REP_ID_BASE + nodeId, data);
 }
 
-/** \brief count down PutChar character send timeout
+/** \brief SDO server on a further CAN bus
  *
- * \param callingFrequency in ms. This is subtracted from the remaining wait time
- * \return void
+ * \param hw CanHardware* of that bus
+ * \param server object dictionary to serve, e.g. the CanSdo of the first bus
+ * \param nodeId node id on that bus
  *
  */
-void CanSdo::TriggerTimeout(int callingFrequency)
+CanSdoPort::CanSdoPort(CanHardware* hw, SdoServer* server, uint8_t nodeId)
+ : canHardware(hw), server(server), nodeId(nodeId)
 {
-   if (printTimeout > 0)
-   {
-      printTimeout -= callingFrequency;
-   }
-   if (printTimeout < 0)
-   {
-      printTimeout = 0;
-   }
+   HandleClear();
 }
 
-void CanSdo::PutChar(char c)
+void CanSdoPort::HandleClear()
 {
-   if (printTimeout == 0) return; //last call to PutChar resulted in a timeout. Do not recover until the next burst
-
-   printTimeout = PRINT_TIMEOUT;
-   //When print buffer is full, wait
-   while (printByteIn == printByteOut && printTimeout > 0);
-
-   PRINT_BUF_ENQUEUE(c);
-   printRequest = -1; //We can clear the print start trigger as we've obviously started printing
+   canHardware->RegisterUserMessage(SDO_REQ_ID_BASE + nodeId);
 }
 
-void CanSdo::SendSdoReply(SdoFrame* sdoFrame)
+void CanSdoPort::HandleRx(uint32_t canId, uint32_t data[2], uint8_t)
 {
-   canHardware->Send(0x580 + nodeId, (uint32_t*)sdoFrame);
-   pendingUserSpaceSdo = false;
-}
+   if (canId != (SDO_REQ_ID_BASE + nodeId)) return;
 
-bool CanSdo::ProcessSpecialSDOObjects(SdoFrame* sdo)
-{
-   if (sdo->index == SDO_INDEX_STRINGS)
-   {
-      if (sdo->cmd == SDO_READ)
-      {
-         #ifdef ARDUINO
-         Serial.printf("SDO UPLOAD INIT: jsonSize=%lu subIndex=%d\r\n", 
-                       jsonSize, sdo->subIndex);
-         #endif
-         ParamJson::BeginStream();
-         jsonSize = ParamJson::GetSize();
-         sdo->data = jsonSize;
-         sdo->cmd = SDO_RESPONSE_UPLOAD | SDO_SIZE_SPECIFIED;
-         printTimeout = PRINT_TIMEOUT;
-         printByteIn = 0;
-         printByteOut = sizeof(printBuffer); //both point to the beginning of the physical buffer but virtually they are 64 bytes apart
-         printRequest = sdo->subIndex;
-         jsonStreamActive = true;
-         return true;
-      }
-   }
-   else
-   {
-      pendingUserSpaceSdo = true;
-      pendingUserSpaceSdoFrame.cmd = sdo->cmd;
-      pendingUserSpaceSdoFrame.index = sdo->index;
-      pendingUserSpaceSdoFrame.subIndex = sdo->subIndex;
-      pendingUserSpaceSdoFrame.data = sdo->data;
-   }
-   return false;
+   if (server->ProcessRequest((SdoServer::SdoFrame*)data, this))
+      canHardware->Send(SDO_REP_ID_BASE + nodeId, data);
+
+   server->RebootIfRequested();
 }
 
-void CanSdo::ReadOrDeleteCanMap(SdoFrame* sdo)
+void CanSdoPort::SetNodeId(uint8_t id)
 {
-   bool rx = (sdo->index & 0x80) != 0;
-   uint32_t canId;
-   uint8_t itemIdx = MAX(0, sdo->subIndex - 1) / 2;
-   const CanMap::CANPOS* canPos = canMap->GetMap(rx, sdo->index & 0x3f, itemIdx, canId);
-
-   if (sdo->cmd == SDO_READ)
-   {
-      if (canPos != 0)
-      {
-         uint16_t id = Param::GetAttrib((Param::PARAM_NUM)canPos->mapParam)->id;
-
-         if (sdo->subIndex == 0) //0 contains COB Id
-            sdo->data = canId;
-         else if (sdo->subIndex & 1) //odd sub indexes have data id, position and length
-            sdo->data = id | (canPos->offsetBits << 16) | (canPos->numBits << 24);
-         else //even sub indexes except 0 have gain and offset
-            sdo->data = (uint32_t)(((int32_t)(canPos->gain * 1000)) & 0xFFFFFF) | (canPos->offset << 24);
-         sdo->cmd = SDO_READ_REPLY;
-      }
-      else
-      {
-         sdo->cmd = SDO_ABORT;
-         sdo->data = SDO_ERR_INVIDX;
-      }
-   }
-   else if (sdo->cmd == SDO_WRITE && canPos != 0 && sdo->data == 0)
-   {
-      canMap->Remove(rx, sdo->index & 0x3f, itemIdx);
-      sdo->cmd = SDO_WRITE_REPLY;
-   }
-   else
-   {
-      sdo->cmd = SDO_ABORT;
-      sdo->data = SDO_ERR_INVIDX;
-   }
+   nodeId = id;
+   canHardware->ClearUserMessages();
 }
 
-void CanSdo::AddCanMap(SdoFrame* sdo, bool rx)
+void CanSdoPort::SendReply(const SdoServer::SdoFrame* reply)
 {
-   if (sdo->cmd == SDO_WRITE)
-   {
-      int result = -1;
-
-      if (sdo->subIndex == 0)
-      {
-         if (sdo->data < 0x20000000 || (sdo->data & ~CAN_FORCE_EXTENDED) < 0x800)
-         {
-            mapId = sdo->data;
-            result = 0;
-         }
-         else
-         {
-            mapId = 0xFFFFFFFF;
-         }
-      }
-      else if (mapId != 0xFFFFFFFF && sdo->subIndex == 1)
-      {
-         //Now we receive UID of value to be mapped along with bit start and length
-         mapInfo.mapParam = Param::NumFromId(sdo->data & 0xFFFF);
-         mapInfo.offsetBits = (sdo->data >> 16) & 0x3F;
-         mapInfo.numBits = ((int32_t)sdo->data >> 24);
-         result = mapInfo.mapParam < Param::PARAM_LAST ? 0 : -1;
-      }
-      else if (mapInfo.numBits != 0 && sdo->subIndex == 2) //This sort of verifies that we received subindex 1
-      {
-         //Now we receive gain and offset and add the map
-
-         // sign extend the 24-bit integer to a 32-bit integer
-         int32_t gainFixedPoint = (sdo->data & 0xFFFFFF) << (32-24);
-         gainFixedPoint >>= (32-24);
-         mapInfo.gain = gainFixedPoint / 1000.0f;
-         mapInfo.offset = sdo->data >> 24;
-
-         if (rx) //RX map
-            result = canMap->AddRecv((Param::PARAM_NUM)mapInfo.mapParam, mapId, mapInfo.offsetBits, mapInfo.numBits, mapInfo.gain, mapInfo.offset);
-         else
-            result = canMap->AddSend((Param::PARAM_NUM)mapInfo.mapParam, mapId, mapInfo.offsetBits, mapInfo.numBits, mapInfo.gain, mapInfo.offset);
+   uint32_t data[2];
 
-         mapInfo.numBits = 0;
-         mapId = 0xFFFFFFFF;
-      }
-
-      if (result >= 0)
-      {
-         sdo->cmd = SDO_WRITE_REPLY;
-      }
-      else
-      {
-         sdo->cmd = SDO_ABORT;
-         sdo->data = SDO_ERR_INVIDX;
-      }
-   }
+   memcpy(data, reply, sizeof(data));
+   canHardware->Send(SDO_REP_ID_BASE + nodeId, data);
 }
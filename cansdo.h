@@ -18,40 +18,24 @@
  */
 #ifndef CANSDO_H
 #define CANSDO_H
-#include "params.h"
-#include "printf.h"
+#include "sdoserver.h"
 #include "canhardware.h"
-#include "canmap.h"
-#include "param_json.h"
 
-#define SDO_REQUEST_DOWNLOAD  (1 << 5)
-#define SDO_REQUEST_UPLOAD    (2 << 5)
-#define SDO_REQUEST_SEGMENT   (3 << 5)
-#define SDO_TOGGLE_BIT        (1 << 4)
-#define SDO_RESPONSE_UPLOAD   (2 << 5)
-#define SDO_RESPONSE_DOWNLOAD (3 << 5)
-#define SDO_EXPEDITED         (1 << 1)
-#define SDO_SIZE_SPECIFIED    (1)
-#define SDO_WRITE             (SDO_REQUEST_DOWNLOAD | SDO_EXPEDITED | SDO_SIZE_SPECIFIED)
-#define SDO_READ              SDO_REQUEST_UPLOAD
-#define SDO_ABORT             0x80
-#define SDO_WRITE_REPLY       SDO_RESPONSE_DOWNLOAD
-#define SDO_READ_REPLY        (SDO_RESPONSE_UPLOAD | SDO_EXPEDITED | SDO_SIZE_SPECIFIED)
-#define SDO_ERR_INVIDX        0x06020000
-#define SDO_ERR_RANGE         0x06090030
-#define SDO_ERR_GENERAL       0x08000000
+#ifndef SDO_MAX_CLIENTS
+#define SDO_MAX_CLIENTS 4
+#endif
 
-class CanSdo: CanCallback, public IPutChar
+/* Receives the SDO replies of all remote nodes, see CanSdo::AddClient() */
+class ISdoClient
 {
    public:
-      struct SdoFrame
-      {
-         uint8_t cmd;
-         uint16_t index;
-         uint8_t subIndex;
-         uint32_t data;
-      } __attribute__((packed));
+      virtual void HandleSdoReply(uint8_t nodeId, const SdoServer::SdoFrame* reply) = 0;
+};
 
+/* SDO server and client on CAN. The object dictionary is in SdoServer */
+class CanSdo: CanCallback, public SdoServer, ISdoTransport
+{
+   public:
       /** Default constructor */
       explicit CanSdo(CanHardware* hw, CanMap* cm = 0);
       CanHardware* GetHardware() { return canHardware; }
@@ -61,44 +45,43 @@ class CanSdo: CanCallback, public IPutChar
       void SDORead(uint8_t nodeId, uint16_t index, uint8_t subIndex);
       bool SDOReadReply(uint32_t& data);
       void RemoteMap(uint8_t nodeId, bool rx, uint32_t cobId, CanMap::CANPOS mapping);
+      bool AddClient(ISdoClient* client);
+      void SDORequest(uint8_t nodeId, const SdoFrame* request);
       void SetNodeId(uint8_t id);
-      int GetPrintRequest() { return printRequest; }
-      SdoFrame* GetPendingUserspaceSdo() { return pendingUserSpaceSdo ? &pendingUserSpaceSdoFrame : 0; }
-      void SendSdoReply(SdoFrame* sdoFrame);
-      void PutChar(char c) override;
-      void TriggerTimeout(int callingFrequency);
-      void SetJsonSize(uint32_t size) { jsonSize = size; }
-      void SetPrintCallback(void (*callback)()) { printCallback = callback; }
 
    private:
       CanHardware* canHardware;
-      CanMap* canMap;
       uint8_t nodeId;
       uint8_t remoteNodeId;
-      int printRequest;
-      //We use a ring buffer with non-wrapping index. This limits us to 4 GB, huh!
-      //In the beginning printBufIn starts at 0 and printBufOut at sizeof(printBuffer) (e.g. 64)
-      //All addressing of printBuffer is modulo buffer size
-      volatile char printBuffer[64]; //Must be a power of 2 for efficient modulo calculation
-      volatile uint32_t printByteIn;
-      volatile uint32_t printByteOut;
-      volatile int printTimeout; //remaining time to wait
-      Param::PARAM_NUM mapParam;
-      uint32_t mapId;
-      CanMap::CANPOS mapInfo;
+      CanMap::CANPOS remoteMapInfo;
       bool sdoReplyValid;
       uint32_t sdoReplyData;
-      SdoFrame pendingUserSpaceSdoFrame;
-      bool pendingUserSpaceSdo;
-      uint32_t jsonSize;
-      void (*printCallback)();
-      bool jsonStreamActive;
+      bool remoteMapping;
+      ISdoClient* clients[SDO_MAX_CLIENTS];
+      uint8_t numClients;
 
+      void SendReply(const SdoFrame* reply) override;
       void ProcessSDO(uint32_t data[2]);
-      bool ProcessSpecialSDOObjects(SdoFrame *sdo);
-      void ReadOrDeleteCanMap(SdoFrame *sdo);
-      void AddCanMap(SdoFrame *sdo, bool rx);
       void InitiateSDOTransfer(uint8_t req, uint8_t nodeId, uint16_t index, uint8_t subIndex, uint32_t data);
 };
 
+/* Serves the object dictionary of a CanSdo or other SdoServer on a further CAN bus,
+   with its own node id. Register it as CanCallback of that bus.
+ */
+class CanSdoPort: CanCallback, ISdoTransport
+{
+   public:
+      CanSdoPort(CanHardware* hw, SdoServer* server, uint8_t nodeId = 1);
+      void HandleClear() override;
+      void HandleRx(uint32_t canId, uint32_t data[2], uint8_t dlc) override;
+      void SetNodeId(uint8_t id);
+
+   private:
+      CanHardware* canHardware;
+      SdoServer* server;
+      uint8_t nodeId;
+
+      void SendReply(const SdoServer::SdoFrame* reply) override;
+};
+
 #endif // CANSDO_H
@@ -0,0 +1,134 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "cobspacket.h"
+#include "crc32.h"
+#include <string.h>
+
+/** \brief Packet encoder
+ *
+ * \param buf transmit buffer
+ * \param size size of buf
+ * \param len number of bytes used in buf, advanced by every packet
+ *
+ */
+CobsWriter::CobsWriter(uint8_t* buf, uint16_t size, uint16_t& len)
+ : buf(buf), size(size), len(len), codePos(0), code(0), crc(0)
+{
+}
+
+/** \brief Check whether a packet fits the transmit buffer, e.g. before doing what it reports
+ *
+ * \param maxLen maximum payload length
+ * \return true if Begin() with this length succeeds
+ *
+ */
+bool CobsWriter::HasSpace(uint16_t maxLen)
+{
+   //Payload, type and CRC plus one code byte per 254 bytes and the delimiter
+   uint32_t encodedLen = maxLen + 5 + (maxLen + 5) / 254 + 2;
+
+   return encodedLen <= (uint32_t)(size - len);
+}
+
+/** \brief Start encoding a packet into the transmit buffer
+ *
+ * \param type packet type
+ * \param maxLen maximum payload length
+ * \return true if the packet fits
+ *
+ */
+bool CobsWriter::Begin(uint8_t type, uint16_t maxLen)
+{
+   if (!HasSpace(maxLen)) return false;
+
+   codePos = len++;
+   code = 1;
+   crc = CRC32_INIT;
+   Put(type);
+   return true;
+}
+
+void CobsWriter::Put(uint8_t b)
+{
+   crc = crc32_bytes(crc, &b, 1);
+
+   if (b != 0)
+   {
+      buf[len++] = b;
+      code++;
+   }
+
+   if (b == 0 || code == 0xFF)
+   {
+      buf[codePos] = code;
+      codePos = len++;
+      code = 1;
+   }
+}
+
+void CobsWriter::Put(const void* data, uint16_t count)
+{
+   for (uint16_t i = 0; i < count; i++)
+      Put(((const uint8_t*)data)[i]);
+}
+
+void CobsWriter::End()
+{
+   uint32_t packetCrc = ~crc;
+
+   Put(&packetCrc, sizeof(packetCrc));
+   buf[codePos] = code;
+   buf[len++] = 0;
+}
+
+/** \brief Decode a received packet in place and check its CRC
+ *
+ * \param packet encoded packet without the 0 delimiter
+ * \param len encoded length
+ * \return length of type and payload at the start of packet, -1 on framing or CRC error
+ *
+ */
+int cobs_decode_packet(uint8_t* packet, int len)
+{
+   int out = 0;
+
+   //The output never overtakes the input
+   for (int i = 0; i < len;)
+   {
+      uint8_t blockCode = packet[i++];
+
+      if (blockCode == 0 || i + blockCode - 1 > len)
+         return -1;
+
+      for (int j = 1; j < blockCode; j++)
+         packet[out++] = packet[i++];
+
+      if (blockCode < 0xFF && i < len)
+         packet[out++] = 0;
+   }
+
+   uint32_t crc;
+
+   if (out < 5) return -1;
+
+   out -= 4;
+   memcpy(&crc, &packet[out], sizeof(crc));
+
+   return crc == ~crc32_bytes(CRC32_INIT, packet, out) ? out : -1;
+}
@@ -0,0 +1,52 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef COBSPACKET_H
+#define COBSPACKET_H
+
+#include <stdint.h>
+
+//Packet types shared by all byte stream transports
+#define PKT_SDO     0x01
+
+/* Binary packets on byte streams: type byte, payload and CRC-32 of both little endian,
+   COBS encoded and terminated by a 0 byte. Used by Console and SdoPipe.
+   The writer appends packets to a transmit buffer that may also hold other output.
+ */
+class CobsWriter
+{
+   public:
+      CobsWriter(uint8_t* buf, uint16_t size, uint16_t& len);
+      bool HasSpace(uint16_t maxLen);
+      bool Begin(uint8_t type, uint16_t maxLen);
+      void Put(uint8_t b);
+      void Put(const void* data, uint16_t len);
+      void End();
+
+   private:
+      uint8_t* buf;
+      uint16_t size;
+      uint16_t& len;
+      uint16_t codePos;
+      uint8_t code;
+      uint32_t crc;
+};
+
+int cobs_decode_packet(uint8_t* packet, int len);
+
+#endif // COBSPACKET_H
@@ -0,0 +1,467 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "console.h"
+
+#ifdef ARDUINO
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "my_math.h"
+#include "param_json.h"
+
+/** \brief Console on a stream
+ *
+ * \param stream e.g. Serial
+ * \param sdo SDO server that processes parameter requests
+ *
+ */
+Console::Console(Stream& stream, SdoServer& sdo)
+ : stream(stream), sdo(sdo), binary(false), job(JobNone), rxLen(0), rxOverflow(false),
+   txLen(0), txPos(0), txPacket(txBuf, sizeof(txBuf), txLen), numStream(0), streamRepeat(0),
+   streamInterval(0), lastStream(0)
+{
+}
+
+/** \brief Process input and continue output, call from loop()
+ *
+ * \param time current time in ms, e.g. millis()
+ *
+ */
+void Console::Task(uint32_t time)
+{
+   Flush();
+
+   //Only produce new output when the previous one has been sent
+   if (txLen > 0) return;
+
+   sdo.RebootIfRequested();
+
+   if (job == JobJson)
+   {
+      ContinueJson();
+   }
+   else if (job == JobStream)
+   {
+      if (stream.available() > 0 || streamRepeat == 0)
+      {
+         //Any input stops the stream, the input itself is discarded
+         while (stream.available() > 0) stream.read();
+         job = JobNone;
+      }
+      else
+      {
+         PutStreamLine();
+         streamRepeat--;
+      }
+   }
+   else
+   {
+      if (binary && streamInterval > 0 && (time - lastStream) >= streamInterval)
+      {
+         lastStream = time;
+         SendStreamPacket(time);
+      }
+
+      ProcessInput();
+   }
+
+   Flush();
+}
+
+/****************** Private methods ********************/
+
+void Console::Flush()
+{
+   if (txPos >= txLen) return;
+
+   int space = stream.availableForWrite();
+
+   if (space <= 0) return;
+
+   uint16_t count = MIN((uint16_t)space, (uint16_t)(txLen - txPos));
+   stream.write(&txBuf[txPos], count);
+   txPos += count;
+
+   if (txPos >= txLen)
+      txLen = txPos = 0;
+}
+
+//Read until a command or packet is complete, then stop so its output can be sent first
+void Console::ProcessInput()
+{
+   while (txLen == 0 && job == JobNone && stream.available() > 0)
+   {
+      char c = stream.read();
+      bool end = binary ? c == 0 : (c == '\n' || c == '\r');
+
+      if (!end)
+      {
+         if (rxLen < CONSOLE_RX_SIZE - 1)
+            rxBuf[rxLen++] = c;
+         else
+            rxOverflow = true;
+         continue;
+      }
+
+      if (rxOverflow)
+      {
+         if (binary)
+            SendError(CONSOLE_ERR_SIZE);
+         else
+            PutText("Line too long\r\n");
+      }
+      else if (binary && rxLen > 0)
+      {
+         ProcessPacket((uint8_t*)rxBuf, rxLen);
+      }
+      else if (!binary && rxLen > 0)
+      {
+         rxBuf[rxLen] = 0;
+         ExecuteLine();
+      }
+
+      rxLen = 0;
+      rxOverflow = false;
+   }
+}
+
+void Console::PutText(const char* str)
+{
+   uint16_t len = MIN((int)strlen(str), CONSOLE_TX_SIZE - txLen);
+   memcpy(&txBuf[txLen], str, len);
+   txLen += len;
+}
+
+//Same format as the openinverter terminal, FP_DECIMALS digits after the point
+void Console::PutValue(float value)
+{
+   char buf[16];
+   float mag = value < 0 ? -value : value;
+
+   if (mag < 4e7f)
+   {
+      uint32_t scaled = mag * UTOA_FRACDEC + 0.5f;
+      snprintf(buf, sizeof(buf), "%s%lu.%0*lu", value < 0 && scaled > 0 ? "-" : "",
+               (unsigned long)(scaled / UTOA_FRACDEC), FP_DECIMALS, (unsigned long)(scaled % UTOA_FRACDEC));
+   }
+   else
+   {
+      snprintf(buf, sizeof(buf), "%s%lu", value < 0 ? "-" : "", (unsigned long)MIN(mag, 4294967295.0f));
+   }
+   PutText(buf);
+}
+
+void Console::ExecuteLine()
+{
+   char* args = strchr(rxBuf, ' ');
+
+   if (args != 0)
+   {
+      *args = 0;
+      args++;
+      while (*args == ' ') args++;
+   }
+   else
+   {
+      args = rxBuf + strlen(rxBuf);
+   }
+
+   //openinverter tools expect the command echoed before the answer
+   PutText(rxBuf);
+   if (*args != 0)
+   {
+      PutText(" ");
+      PutText(args);
+   }
+   PutText("\r\n");
+
+   if (strcmp(rxBuf, "get") == 0)
+   {
+      Get(args);
+   }
+   else if (strcmp(rxBuf, "set") == 0)
+   {
+      Set(args);
+   }
+   else if (strcmp(rxBuf, "save") == 0)
+   {
+      Save();
+   }
+   else if (strcmp(rxBuf, "json") == 0)
+   {
+      ParamJson::Build();
+      ParamJson::BeginStream();
+      job = JobJson;
+   }
+   else if (strcmp(rxBuf, "stream") == 0)
+   {
+      StartStream(args);
+   }
+   else if (strcmp(rxBuf, "binary") == 0)
+   {
+      PutText("OK\r\n");
+      binary = true;
+      streamInterval = 0;
+   }
+   else
+   {
+      PutText("Unknown command sequence\r\n");
+   }
+}
+
+void Console::Get(char* names)
+{
+   for (char* name = strtok(names, ","); name != 0; name = strtok(0, ","))
+   {
+      Param::PARAM_NUM param = Param::NumFromString(name);
+      uint32_t data;
+
+      if (param < Param::PARAM_LAST && Request(SDO_READ, param, data))
+         PutValue(FP_TOFLOAT((s32fp)data));
+      else
+         PutText("Unknown parameter");
+      PutText("\r\n");
+   }
+}
+
+void Console::Set(char* args)
+{
+   char* value = strchr(args, ' ');
+
+   if (value == 0)
+   {
+      PutText("Usage: set name value\r\n");
+      return;
+   }
+
+   *value++ = 0;
+
+   Param::PARAM_NUM param = Param::NumFromString(args);
+   uint32_t data = FP_FROMFLT((float)atof(value));
+
+   if (param >= Param::PARAM_LAST)
+      PutText("Unknown parameter\r\n");
+   else if (Request(SDO_WRITE, param, data))
+      PutText("Set OK\r\n");
+   else
+      PutText("Value out of range\r\n");
+}
+
+void Console::Save()
+{
+   SdoServer::SdoFrame frame = { SDO_WRITE, SDO_INDEX_COMMAND, 0, 0 };
+
+   if (sdo.ProcessRequest(&frame) && frame.cmd != SDO_ABORT)
+      PutText("Parameters stored\r\n");
+   else
+      PutText("Error storing parameters\r\n");
+}
+
+void Console::StartStream(char* args)
+{
+   char* end;
+
+   streamRepeat = strtoul(args, &end, 10);
+   numStream = 0;
+
+   for (char* name = strtok(end, ", "); name != 0 && numStream < CONSOLE_MAX_STREAM; name = strtok(0, ", "))
+   {
+      Param::PARAM_NUM param = Param::NumFromString(name);
+
+      if (param >= Param::PARAM_LAST)
+      {
+         PutText("Unknown parameter\r\n");
+         return;
+      }
+      streamParams[numStream++] = param;
+   }
+
+   if (numStream > 0)
+      job = JobStream;
+}
+
+void Console::ContinueJson()
+{
+   uint16_t space = CONSOLE_TX_SIZE - txLen;
+   size_t count = ParamJson::Read(&txBuf[txLen], space);
+
+   txLen += count;
+
+   if (count < space)
+   {
+      PutText("\r\n");
+      job = JobNone;
+   }
+}
+
+void Console::PutStreamLine()
+{
+   for (int i = 0; i < numStream; i++)
+   {
+      if (i > 0) PutText(",");
+      PutValue(Param::GetFloat(streamParams[i]));
+   }
+   PutText("\r\n");
+}
+
+//Read or write a parameter through the SDO object dictionary, addressed by its unique id
+bool Console::Request(uint8_t cmd, Param::PARAM_NUM param, uint32_t& data)
+{
+   uint16_t id = Param::GetAttrib(param)->id;
+   SdoServer::SdoFrame frame = { cmd, (uint16_t)(SDO_INDEX_PARAM_UID | (id >> 8)), (uint8_t)(id & 0xFF), data };
+
+   bool replied = sdo.ProcessRequest(&frame);
+   data = frame.data;
+
+   return replied && frame.cmd != SDO_ABORT;
+}
+
+/** \brief Handle a received COBS encoded packet: type, payload, CRC-32 of both little endian */
+void Console::ProcessPacket(uint8_t* packet, int len)
+{
+   int out = cobs_decode_packet(packet, len);
+
+   if (out < 1)
+   {
+      SendError(CONSOLE_ERR_FRAME);
+      return;
+   }
+
+   uint8_t type = packet[0];
+   uint8_t* data = &packet[1];
+   int dataLen = out - 1;
+
+   if (type == CONSOLE_PKT_SDO && (dataLen % 8) == 0)
+   {
+      //The requests are only executed when all their replies can be sent
+      if (!txPacket.HasSpace(dataLen))
+      {
+         SendError(CONSOLE_ERR_SIZE);
+         return;
+      }
+
+      //Requests answered later by user space arrive in a packet of their own
+      int replies = sdo.ProcessBatch(data, dataLen / 8, this);
+
+      if (replies > 0 && txPacket.Begin(CONSOLE_PKT_SDO, replies * 8))
+      {
+         txPacket.Put(data, replies * 8);
+         txPacket.End();
+      }
+   }
+   else if (type == CONSOLE_PKT_READ && (dataLen % 2) == 0)
+   {
+      for (int i = 0; i < dataLen; i += 2)
+      {
+         if (Param::NumFromId(data[i] | (data[i + 1] << 8)) >= Param::PARAM_LAST)
+         {
+            SendError(CONSOLE_ERR_PARAM);
+            return;
+         }
+      }
+
+      if (!txPacket.Begin(CONSOLE_PKT_READ, dataLen * 2))
+      {
+         SendError(CONSOLE_ERR_SIZE);
+         return;
+      }
+
+      for (int i = 0; i < dataLen; i += 2)
+      {
+         float value = Param::GetFloat(Param::NumFromId(data[i] | (data[i + 1] << 8)));
+         txPacket.Put(&value, sizeof(value));
+      }
+      txPacket.End();
+   }
+   else if (type == CONSOLE_PKT_STREAM && dataLen >= 2 && (dataLen % 2) == 0)
+   {
+      if ((dataLen - 2) / 2 > CONSOLE_MAX_STREAM)
+      {
+         SendError(CONSOLE_ERR_SIZE);
+         return;
+      }
+
+      numStream = 0;
+
+      for (int i = 2; i < dataLen; i += 2)
+      {
+         Param::PARAM_NUM param = Param::NumFromId(data[i] | (data[i + 1] << 8));
+
+         if (param >= Param::PARAM_LAST)
+         {
+            numStream = 0;
+            SendError(CONSOLE_ERR_PARAM);
+            return;
+         }
+         streamParams[numStream++] = param;
+      }
+
+      streamInterval = numStream > 0 ? data[0] | (data[1] << 8) : 0;
+
+      if (txPacket.Begin(CONSOLE_PKT_STREAM, 0))
+         txPacket.End();
+   }
+   else if (type == CONSOLE_PKT_TEXT)
+   {
+      if (txPacket.Begin(CONSOLE_PKT_TEXT, 0))
+         txPacket.End();
+      binary = false;
+      streamInterval = 0;
+   }
+   else
+   {
+      SendError(CONSOLE_ERR_TYPE);
+   }
+}
+
+void Console::SendError(uint8_t error)
+{
+   if (txPacket.Begin(CONSOLE_PKT_ERROR, 1))
+   {
+      txPacket.Put(error);
+      txPacket.End();
+   }
+}
+
+//Sent at the stream interval, skipped when the previous output is still pending
+void Console::SendStreamPacket(uint32_t time)
+{
+   if (!txPacket.Begin(CONSOLE_PKT_DATA, 4 + numStream * 4)) return;
+
+   txPacket.Put(&time, sizeof(time));
+
+   for (int i = 0; i < numStream; i++)
+   {
+      float value = Param::GetFloat(streamParams[i]);
+      txPacket.Put(&value, sizeof(value));
+   }
+   txPacket.End();
+}
+
+//Reply from user space to a request of an earlier batch, dropped when the buffer is full
+void Console::SendReply(const SdoServer::SdoFrame* reply)
+{
+   if (txPacket.Begin(CONSOLE_PKT_SDO, sizeof(*reply)))
+   {
+      txPacket.Put(reply, sizeof(*reply));
+      txPacket.End();
+   }
+}
+
+#endif // ARDUINO
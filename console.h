@@ -0,0 +1,116 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include "sdoserver.h"
+#include "cobspacket.h"
+
+//Longest command line or encoded binary packet
+#ifndef CONSOLE_RX_SIZE
+#define CONSOLE_RX_SIZE 256
+#endif
+
+#ifndef CONSOLE_TX_SIZE
+#define CONSOLE_TX_SIZE 512
+#endif
+
+//Maximum number of values in one stream
+#ifndef CONSOLE_MAX_STREAM
+#define CONSOLE_MAX_STREAM 32
+#endif
+
+#define CONSOLE_PKT_SDO     PKT_SDO
+#define CONSOLE_PKT_READ    0x02
+#define CONSOLE_PKT_STREAM  0x03
+#define CONSOLE_PKT_TEXT    0x7F
+#define CONSOLE_PKT_DATA    0x83
+#define CONSOLE_PKT_ERROR   0xFF
+
+#define CONSOLE_ERR_FRAME   1
+#define CONSOLE_ERR_PARAM   2
+#define CONSOLE_ERR_TYPE    3
+#define CONSOLE_ERR_SIZE    4
+
+/* Parameter access over a Stream like Serial, with the openinverter terminal commands
+      get name[,name...]     print values
+      set name value         change a parameter
+      save                   store parameters in EEPROM
+      json                   print all parameters as JSON
+      stream n name[,name..] print values n times, any input stops it
+      binary                 switch to binary packets, see README
+   Reads, writes and save are processed by SdoServer::ProcessRequest(), so they behave as via CAN.
+   Task() never waits: input is handled as it arrives and output is written as far as
+   availableForWrite() allows, so the stream must implement it.
+ */
+class Console: ISdoTransport
+{
+   public:
+      Console(Stream& stream, SdoServer& sdo);
+      void Task(uint32_t time);
+      bool IsBinary() { return binary; }
+
+   private:
+      enum jobs
+      {
+         JobNone,
+         JobJson,
+         JobStream
+      };
+
+      Stream& stream;
+      SdoServer& sdo;
+      bool binary;
+      enum jobs job;
+      char rxBuf[CONSOLE_RX_SIZE];
+      uint16_t rxLen;
+      bool rxOverflow;
+      uint8_t txBuf[CONSOLE_TX_SIZE];
+      uint16_t txLen;
+      uint16_t txPos;
+      CobsWriter txPacket;
+      Param::PARAM_NUM streamParams[CONSOLE_MAX_STREAM];
+      uint8_t numStream;
+      uint32_t streamRepeat;
+      uint16_t streamInterval;
+      uint32_t lastStream;
+
+      void Flush();
+      void ProcessInput();
+      void PutText(const char* str);
+      void PutValue(float value);
+      void ExecuteLine();
+      void Get(char* names);
+      void Set(char* args);
+      void Save();
+      void StartStream(char* args);
+      void ContinueJson();
+      void PutStreamLine();
+      bool Request(uint8_t cmd, Param::PARAM_NUM param, uint32_t& data);
+      void ProcessPacket(uint8_t* packet, int len);
+      void SendError(uint8_t error);
+      void SendStreamPacket(uint32_t time);
+      void SendReply(const SdoServer::SdoFrame* reply) override;
+};
+
+#endif // ARDUINO
+
+#endif // CONSOLE_H
@@ -0,0 +1,32 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CRC32_H_INCLUDED
+#define CRC32_H_INCLUDED
+
+#include <stdint.h>
+
+#define CRC32_INIT 0xFFFFFFFF
+
+uint32_t crc32_word(uint32_t crc, uint32_t word);
+uint32_t crc32_update(uint32_t crc, const uint32_t *data, uint32_t length);
+uint32_t crc32_block(const uint32_t *data, uint32_t length);
+uint32_t crc32_bytes(uint32_t crc, const uint8_t *data, uint32_t length);
+uint16_t crc16_bytes(uint16_t crc, const uint8_t *data, uint32_t length);
+
+#endif // CRC32_H_INCLUDED
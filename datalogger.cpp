@@ -0,0 +1,188 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "datalogger.h"
+#include <string.h>
+
+static_assert(4 + LOGGER_MAX_CHANNELS * sizeof(float) <= LOGGER_BUFFER_SIZE, "LOGGER_BUFFER_SIZE too small for one record");
+static_assert(LOGGER_BUFFER_SIZE <= 65535, "LOGGER_BUFFER_SIZE must fit the 16 bit fill level");
+
+DataLogger::DataLogger()
+ : logSink(0), full(0), active(0), running(false), recordCount(0), droppedCount(0),
+   numChannels(0), writeError(false)
+{
+   fill[0] = fill[1] = 0;
+}
+
+/** \brief Add a parameter to the record, only possible while stopped
+ *
+ * \param param parameter or spot value to log
+ * \return true: success, false: logger running or LOGGER_MAX_CHANNELS reached
+ *
+ */
+bool DataLogger::AddChannel(Param::PARAM_NUM param)
+{
+   if (running || numChannels >= LOGGER_MAX_CHANNELS || param >= Param::PARAM_LAST) return false;
+
+   channels[numChannels++] = param;
+   return true;
+}
+
+void DataLogger::ClearChannels()
+{
+   if (!running) numChannels = 0;
+}
+
+/** \brief Write the header and start accepting records
+ *
+ * \param sink destination, e.g. an SdLogSink
+ * \param interval logging interval in units of the Log() timestamp, only stored in the header
+ * \return true: started, false: no channels or header could not be written
+ *
+ */
+bool DataLogger::Start(LogSink* sink, uint32_t interval)
+{
+   if (running || numChannels == 0) return false;
+
+   logSink = sink;
+   fill[0] = fill[1] = 0;
+   full = 0;
+   active = 0;
+   recordCount = 0;
+   droppedCount = 0;
+   writeError = !WriteHeader(interval);
+   running = !writeError;
+
+   return running;
+}
+
+/** \brief Stop logging and write all buffered records */
+void DataLogger::Stop()
+{
+   if (!running) return;
+
+   //Log() returns right away from now on, so the buffers are no longer shared with it
+   __atomic_store_n(&running, false, __ATOMIC_SEQ_CST);
+   Task();
+
+   if (fill[active] > 0)
+      WriteBuffer(active);
+
+   logSink->Flush();
+}
+
+/** \brief Take a snapshot of all channels
+ * Drops the record when both buffers are waiting to be written
+ *
+ * \param timestamp time of the record, e.g. micros()
+ * \return void
+ *
+ */
+void DataLogger::Log(uint32_t timestamp)
+{
+   if (!running) return;
+
+   uint16_t recordSize = RecordSize();
+   int idx = active;
+
+   if (fill[idx] + recordSize > LOGGER_BUFFER_SIZE)
+   {
+      //The other buffer is only free once Task() has written it and reset its fill level
+      if ((__atomic_load_n(&full, __ATOMIC_ACQUIRE) & (1 << (idx ^ 1))) || fill[idx ^ 1] != 0)
+      {
+         droppedCount++;
+         return;
+      }
+
+      __atomic_fetch_or(&full, 1 << idx, __ATOMIC_RELEASE);
+      idx ^= 1;
+      active = idx;
+   }
+
+   uint8_t* record = &buffer[idx][fill[idx]];
+
+   memcpy(record, &timestamp, 4);
+
+   for (int i = 0; i < numChannels; i++)
+   {
+      float value = Param::GetFloat(channels[i]);
+      memcpy(record + 4 + i * sizeof(float), &value, sizeof(float));
+   }
+
+   fill[idx] += recordSize;
+   recordCount++;
+}
+
+/** \brief Write full buffers to the sink, call from the main loop */
+void DataLogger::Task()
+{
+   //When both are full the inactive one is older
+   int first = active ^ 1;
+
+   for (int i = 0; i < 2; i++)
+   {
+      int idx = first ^ i;
+
+      if (__atomic_load_n(&full, __ATOMIC_ACQUIRE) & (1 << idx))
+      {
+         WriteBuffer(idx);
+         //Log() sets the other bit from the interrupt, so clear ours atomically
+         __atomic_fetch_and(&full, ~(1 << idx), __ATOMIC_RELEASE);
+      }
+   }
+}
+
+/****************** Private methods ********************/
+
+bool DataLogger::WriteHeader(uint32_t interval)
+{
+   uint8_t header[12];
+   uint32_t magic = LOGGER_MAGIC;
+   uint16_t recordSize = RecordSize();
+
+   memcpy(header, &magic, 4);
+   header[4] = LOGGER_VERSION;
+   header[5] = numChannels;
+   memcpy(&header[6], &recordSize, 2);
+   memcpy(&header[8], &interval, 4);
+
+   if (!logSink->Write(header, sizeof(header))) return false;
+
+   for (int i = 0; i < numChannels; i++)
+   {
+      uint16_t id = Param::GetAttrib(channels[i])->id;
+      uint8_t desc[3] = { (uint8_t)id, (uint8_t)(id >> 8), (uint8_t)Param::GetType(channels[i]) };
+      const char* name = Param::GetName(channels[i]);
+      const char* unit = Param::GetUnit(channels[i]);
+
+      if (!logSink->Write(desc, sizeof(desc)) ||
+          !logSink->Write((const uint8_t*)name, strlen(name) + 1) ||
+          !logSink->Write((const uint8_t*)unit, strlen(unit) + 1))
+         return false;
+   }
+
+   return true;
+}
+
+void DataLogger::WriteBuffer(int idx)
+{
+   if (!logSink->Write(buffer[idx], fill[idx]))
+      writeError = true;
+
+   fill[idx] = 0;
+}
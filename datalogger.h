@@ -0,0 +1,119 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DATALOGGER_H
+#define DATALOGGER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "params.h"
+
+#ifdef ARDUINO
+#include <SD.h>
+#else
+#include <stdio.h>
+#endif
+
+#ifndef LOGGER_MAX_CHANNELS
+#define LOGGER_MAX_CHANNELS 64
+#endif
+
+//Size of each of the two record buffers. Multiples of 512 match the SD sector size.
+//One buffer must hold the records logged while the other is written, e.g. 50 channels
+//at 1 kHz fill 204 kB/s, so 32 kB bridge SD write stalls of up to 160 ms
+#ifndef LOGGER_BUFFER_SIZE
+#define LOGGER_BUFFER_SIZE 32768
+#endif
+
+#define LOGGER_MAGIC   0x474C494F //"OILG"
+#define LOGGER_VERSION 1
+
+/** \brief Destination of the log data, written from DataLogger::Task() */
+class LogSink
+{
+   public:
+      virtual bool Write(const uint8_t* data, size_t len) = 0;
+      virtual void Flush() {}
+};
+
+#ifdef ARDUINO
+class SdLogSink: public LogSink
+{
+   public:
+      explicit SdLogSink(File& f) : file(f) {}
+      bool Write(const uint8_t* data, size_t len) override { return file.write(data, len) == len; }
+      void Flush() override { file.flush(); }
+
+   private:
+      File& file;
+};
+#else
+class FileLogSink: public LogSink
+{
+   public:
+      explicit FileLogSink(FILE* f) : file(f) {}
+      bool Write(const uint8_t* data, size_t len) override { return fwrite(data, 1, len, file) == len; }
+      void Flush() override { fflush(file); }
+
+   private:
+      FILE* file;
+};
+#endif
+
+/* Binary log of selected parameters.
+   The file starts with a header: magic, version, channel count, record size, interval and
+   for each channel its id, type, name and unit as zero terminated strings.
+   It is followed by records of a 32-bit timestamp and one float per channel, all little endian.
+   Log() may be called from a timer interrupt, it only copies into the active buffer.
+   Full buffers are written to the sink by Task() from the main loop.
+ */
+class DataLogger
+{
+   public:
+      DataLogger();
+      bool AddChannel(Param::PARAM_NUM param);
+      void ClearChannels();
+      int GetNumChannels() { return numChannels; }
+      bool Start(LogSink* sink, uint32_t interval);
+      void Stop();
+      bool IsRunning() { return running; }
+      void Log(uint32_t timestamp);
+      void Task();
+      uint32_t GetRecordCount() { return recordCount; }
+      uint32_t GetDroppedCount() { return droppedCount; }
+      bool HasWriteError() { return writeError; }
+
+   private:
+      LogSink* logSink;
+      Param::PARAM_NUM channels[LOGGER_MAX_CHANNELS];
+      uint8_t buffer[2][LOGGER_BUFFER_SIZE];
+      volatile uint16_t fill[2];
+      volatile uint8_t full; //bit mask of buffers waiting for Task()
+      volatile uint8_t active;
+      volatile bool running;
+      volatile uint32_t recordCount;
+      volatile uint32_t droppedCount;
+      uint8_t numChannels;
+      bool writeError;
+
+      bool WriteHeader(uint32_t interval);
+      void WriteBuffer(int idx);
+      uint16_t RecordSize() { return 4 + numChannels * sizeof(float); }
+};
+
+#endif // DATALOGGER_H
@@ -0,0 +1,178 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2011 Johannes Huebner <dev@johanneshuebner.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "errormessage.h"
+
+//The error log is a ring buffer with non-wrapping position, like the CanSdo print buffer.
+//Post() reserves a slot with an atomic increment and publishes it via the sequence
+//field, so it may be called from interrupt context without locking.
+#define ERROR_SLOT(pos)   errorBuffer[(pos) & (ERROR_BUF_SIZE - 1)]
+
+#define ERROR_MESSAGE_ENTRY(id, type) type,
+static const uint8_t errorTypes[] =
+{
+   ERROR_DISPLAY,
+   ERROR_MESSAGE_LIST
+};
+#undef ERROR_MESSAGE_ENTRY
+
+ErrorMessage::ERRORENTRY ErrorMessage::errorBuffer[ERROR_BUF_SIZE];
+volatile uint32_t ErrorMessage::writePos = 0;
+volatile uint32_t ErrorMessage::lastPos[ERROR_MESSAGE_LAST];
+volatile uint32_t ErrorMessage::currentTime = 0;
+
+/** \brief Set the time that is recorded with posted errors
+ *
+ * \param time current time in application units, e.g. millis()
+ *
+ */
+void ErrorMessage::SetTime(uint32_t time)
+{
+   currentTime = time;
+}
+
+/** \brief Post an error message to the log
+ * When the same error is still in the log only its occurrence counter is incremented
+ * \param err error message number
+ *
+ */
+void ErrorMessage::Post(ERROR_MESSAGE_NUM err)
+{
+   if (err <= ERROR_NONE || err >= ERROR_MESSAGE_LAST) return;
+
+   uint32_t last = lastPos[err];
+
+   if (last != 0 && (writePos - (last - 1)) <= ERROR_BUF_SIZE)
+   {
+      ERRORENTRY& entry = ERROR_SLOT(last - 1);
+
+      if (entry.seq == last && entry.msg == err)
+      {
+         if (entry.count < 0xFFFF)
+            __atomic_fetch_add(&entry.count, 1, __ATOMIC_RELAXED);
+         return;
+      }
+   }
+
+   uint32_t pos = __atomic_fetch_add(&writePos, 1, __ATOMIC_RELAXED);
+   ERRORENTRY& entry = ERROR_SLOT(pos);
+
+   entry.seq = 0;
+   entry.time = currentTime;
+   entry.msg = err;
+   entry.count = 1;
+   __atomic_store_n(&entry.seq, pos + 1, __ATOMIC_RELEASE);
+   lastPos[err] = pos + 1;
+}
+
+ERROR_MESSAGE_NUM ErrorMessage::GetLastError()
+{
+   return (ERROR_MESSAGE_NUM)GetErrorNum(0);
+}
+
+ERROR_TYPE ErrorMessage::GetType(ERROR_MESSAGE_NUM err)
+{
+   return err < ERROR_MESSAGE_LAST ? (ERROR_TYPE)errorTypes[err] : ERROR_DISPLAY;
+}
+
+/** \brief Get error number of a logged error
+ *
+ * \param index 0 is the most recent error
+ * \return error number or ERROR_NONE when index is not populated
+ *
+ */
+uint32_t ErrorMessage::GetErrorNum(uint8_t index)
+{
+   ERRORENTRY entry;
+   return ReadRecent(index, entry) ? entry.msg : (uint32_t)ERROR_NONE;
+}
+
+/** \brief Get time of first occurrence of a logged error
+ *
+ * \param index 0 is the most recent error
+ * \return time as set with SetTime()
+ *
+ */
+uint32_t ErrorMessage::GetErrorTime(uint8_t index)
+{
+   ERRORENTRY entry;
+   return ReadRecent(index, entry) ? entry.time : 0;
+}
+
+/** \brief Get number of occurrences of a logged error
+ *
+ * \param index 0 is the most recent error
+ * \return number of times the error was posted
+ *
+ */
+uint32_t ErrorMessage::GetErrorCount(uint8_t index)
+{
+   ERRORENTRY entry;
+   return ReadRecent(index, entry) ? entry.count : 0;
+}
+
+/** \brief Get the total number of log entries ever written
+ * Entries between GetPosition() - ERROR_BUF_SIZE and GetPosition() - 1 can be read with ReadEntry()
+ */
+uint32_t ErrorMessage::GetPosition()
+{
+   return writePos;
+}
+
+/** \brief Read a log entry by its absolute position
+ *
+ * \param position absolute position of entry
+ * \param[out] err error number
+ * \param[out] time time of first occurrence
+ * \param[out] count number of occurrences
+ * \return true: entry valid, false: entry not yet written or already overwritten
+ *
+ */
+bool ErrorMessage::ReadEntry(uint32_t position, ERROR_MESSAGE_NUM& err, uint32_t& time, uint16_t& count)
+{
+   ERRORENTRY& entry = ERROR_SLOT(position);
+   uint32_t seq = __atomic_load_n(&entry.seq, __ATOMIC_ACQUIRE);
+
+   if (seq != position + 1) return false;
+
+   err = (ERROR_MESSAGE_NUM)entry.msg;
+   time = entry.time;
+   count = entry.count;
+
+   //Entry was overwritten by an interrupt while we were reading it
+   __atomic_thread_fence(__ATOMIC_ACQUIRE);
+   return __atomic_load_n(&entry.seq, __ATOMIC_ACQUIRE) == seq;
+}
+
+/****************** Private methods ********************/
+
+bool ErrorMessage::ReadRecent(uint8_t index, ERRORENTRY& entry)
+{
+   uint32_t pos = writePos;
+   ERROR_MESSAGE_NUM err;
+   uint16_t count;
+
+   if (index >= ERROR_BUF_SIZE || index >= pos) return false;
+
+   pos -= index + 1;
+   if (!ReadEntry(pos, err, entry.time, count)) return false;
+
+   entry.msg = err;
+   entry.count = count;
+   return true;
+}
@@ -1,16 +1,76 @@
 /*
- * Simplified error message handling for Arduino port
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2011 Johannes Huebner <dev@johanneshuebner.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #ifndef ERRORMESSAGE_H
 #define ERRORMESSAGE_H
 
 #include <stdint.h>
+#include "errormessage_prj.h"
+
+//Must be a power of 2 for efficient modulo calculation
+#ifndef ERROR_BUF_SIZE
+#define ERROR_BUF_SIZE 16
+#endif
+
+#define ERROR_MESSAGE_ENTRY(id, type) ERR_##id,
+typedef enum
+{
+   ERROR_NONE,
+   ERROR_MESSAGE_LIST
+   ERROR_MESSAGE_LAST
+} ERROR_MESSAGE_NUM;
+#undef ERROR_MESSAGE_ENTRY
+
+typedef enum
+{
+   ERROR_DISPLAY,
+   ERROR_DERATE,
+   ERROR_STOP
+} ERROR_TYPE;
 
 class ErrorMessage
 {
 public:
-   static uint32_t GetErrorNum(uint8_t index) { return 0; }
-   static uint32_t GetErrorTime(uint8_t index) { return 0; }
+   static void SetTime(uint32_t time);
+   static void Post(ERROR_MESSAGE_NUM err);
+   static ERROR_MESSAGE_NUM GetLastError();
+   static ERROR_TYPE GetType(ERROR_MESSAGE_NUM err);
+   static uint32_t GetErrorNum(uint8_t index);
+   static uint32_t GetErrorTime(uint8_t index);
+   static uint32_t GetErrorCount(uint8_t index);
+   static uint32_t GetPosition();
+   static bool ReadEntry(uint32_t position, ERROR_MESSAGE_NUM& err, uint32_t& time, uint16_t& count);
+
+private:
+   struct ERRORENTRY
+   {
+      volatile uint32_t seq; //position + 1 once the entry is complete, 0 while it is written
+      uint32_t time;
+      uint16_t msg;
+      volatile uint16_t count;
+   };
+
+   static ERRORENTRY errorBuffer[ERROR_BUF_SIZE];
+   static volatile uint32_t writePos;
+   static volatile uint32_t lastPos[ERROR_MESSAGE_LAST];
+   static volatile uint32_t currentTime;
+
+   static bool ReadRecent(uint8_t index, ERRORENTRY& entry);
 };
 
 #endif // ERRORMESSAGE_H
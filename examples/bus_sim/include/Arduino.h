@@ -0,0 +1,34 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*  Host build only: the library sources used by the simulation include Arduino.h,
+    none of them needs anything from the Arduino core when ARDUINO is not defined.
+ */
+#ifndef ARDUINO_H_HOST_SHIM
+#define ARDUINO_H_HOST_SHIM
+
+#ifdef ARDUINO
+#error "Host shim, remove examples/bus_sim/include from the include path"
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#endif // ARDUINO_H_HOST_SHIM
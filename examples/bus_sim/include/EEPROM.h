@@ -0,0 +1,65 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*  Host build only: RAM backed EEPROM of the size of the Teensy 4.1 EEPROM emulation,
+    with the part of the EEPROMClass interface the library uses.
+    The storage is defined in src/eeprom.cpp. All nodes of a simulation share it
+    like they share the parameters, see README "Bus Simulation".
+ */
+#ifndef EEPROM_H_HOST_SHIM
+#define EEPROM_H_HOST_SHIM
+
+#ifdef ARDUINO
+#error "Host shim, remove examples/bus_sim/include from the include path"
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#ifndef E2END
+#define E2END 0x10BB
+#endif
+
+class EEPROMClass
+{
+    public:
+        uint8_t read(int idx) { return mem[idx]; }
+        void write(int idx, uint8_t val) { mem[idx] = val; }
+        void update(int idx, uint8_t val) { mem[idx] = val; }
+        uint16_t length() { return E2END + 1; }
+
+        template <typename T> T& get(int idx, T& t)
+        {
+            memcpy(&t, &mem[idx], sizeof(T));
+            return t;
+        }
+
+        template <typename T> const T& put(int idx, const T& t)
+        {
+            memcpy(&mem[idx], &t, sizeof(T));
+            return t;
+        }
+
+    private:
+        uint8_t mem[E2END + 1];
+};
+
+extern EEPROMClass EEPROM;
+
+#endif // EEPROM_H_HOST_SHIM
@@ -0,0 +1,31 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <EEPROM.h>
+
+EEPROMClass EEPROM;
+
+// Erased EEPROM reads as 0xFF as on the Teensy
+static struct EepromInit
+{
+    EepromInit()
+    {
+        for (int i = 0; i <= E2END; i++)
+            EEPROM.write(i, 0xFF);
+    }
+} eepromInit;
@@ -0,0 +1,208 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*  Host simulation of several libopeninv nodes on one CAN bus.
+    Every node has its own CanHardwareSim, CanMap and CanSdo and sends one mapped message
+    every 10 ms, all at the same time, so the arbitration shows in the latency of the higher
+    ids. Node 1 also reads the parameter checksum of the other nodes via SDO in turn.
+    The program prints the bus load per 50 ms and the latency of each node.
+    Build with "pio run -e native_bus_sim" and run
+    .pio/build/native_bus_sim/program [nodes] [error rate], e.g. "program 24 0.01".
+    All nodes share the parameters of this process, see README "Bus Simulation".
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "canbussim.h"
+#include "canmap.h"
+#include "cansdo.h"
+#include "params.h"
+
+static const uint64_t kStep = 100000;       // 100 us in ns
+static const uint32_t kDuration = 1000;     // ms
+static const uint32_t kSendPeriod = 10;     // ms
+static const uint32_t kSdoPeriod = 20;      // ms
+static const uint64_t kLoadInterval = 50000000; // 50 ms in ns
+
+// CanMap and CanSdo inherit CanCallback privately, this passes the frames on
+template <class T>
+class CanForward: public CanCallback
+{
+    public:
+        explicit CanForward(T& target) : target(target) {}
+        void HandleRx(uint32_t canId, uint32_t data[2], uint8_t dlc) override { target.HandleRx(canId, data, dlc); }
+        void HandleClear() override { target.HandleClear(); }
+
+    private:
+        T& target;
+};
+
+struct Node
+{
+    CanHardwareSim hw;
+    CanMap canMap;
+    CanSdo canSdo;
+    CanForward<CanMap> mapCallback;
+    CanForward<CanSdo> sdoCallback;
+
+    Node(CanBusSim& bus, uint8_t nodeId)
+        : hw(bus), canMap(&hw, false), canSdo(&hw, &canMap), mapCallback(canMap), sdoCallback(canSdo)
+    {
+        canSdo.SetNodeId(nodeId);
+        hw.AddCallback(&mapCallback);
+        hw.AddCallback(&sdoCallback);
+    }
+};
+
+// Round trip of the SDO requests of node 1, measured in bus time
+class SdoProbe: public ISdoClient
+{
+    public:
+        explicit SdoProbe(CanBusSim& bus) : bus(bus), sent(0), replies(0), sum(0), min(UINT64_MAX), max(0), start(0) {}
+
+        void Request(CanSdo& client, uint8_t nodeId)
+        {
+            SdoServer::SdoFrame request = { SDO_READ, SDO_INDEX_CHECKSUM, 0, 0 };
+
+            start = bus.GetTime();
+            sent++;
+            client.SDORequest(nodeId, &request);
+        }
+
+        void HandleSdoReply(uint8_t, const SdoServer::SdoFrame*) override
+        {
+            uint64_t rtt = bus.GetTime() - start;
+
+            replies++;
+            sum += rtt;
+            if (rtt < min) min = rtt;
+            if (rtt > max) max = rtt;
+        }
+
+        void Report()
+        {
+            printf("SDO from node 1: %u requests, %u replies", sent, replies);
+            if (replies > 0)
+                printf(", round trip min %.0f mean %.0f max %.0f us", min / 1000.0, sum / 1000.0 / replies, max / 1000.0);
+            printf("\n");
+        }
+
+    private:
+        CanBusSim& bus;
+        uint32_t sent;
+        uint32_t replies;
+        uint64_t sum;
+        uint64_t min;
+        uint64_t max;
+        uint64_t start;
+};
+
+static void PrintLoad(uint64_t time, float load)
+{
+    char bar[51];
+    int len = (int)(load * 50 + 0.5f);
+
+    for (int i = 0; i < 50; i++)
+        bar[i] = i < len ? '#' : ' ';
+    bar[50] = 0;
+    printf("%5llu ms %5.1f %% |%s|\n", (unsigned long long)(time / 1000000), load * 100, bar);
+}
+
+int main(int argc, char* argv[])
+{
+    int numNodes = argc > 1 ? atoi(argv[1]) : 16;
+    float errorRate = argc > 2 ? atof(argv[2]) : 0;
+
+    if (numNodes < 2 || numNodes > CANSIM_MAX_NODES)
+    {
+        printf("Number of nodes must be 2..%d\n", CANSIM_MAX_NODES);
+        return 1;
+    }
+
+    CanBusSim bus(CanHardware::Baud500);
+    Node* nodes[CANSIM_MAX_NODES];
+    SdoProbe probe(bus);
+
+    bus.SetErrorRate(errorRate);
+    bus.SetLoadCallback(kLoadInterval, PrintLoad);
+
+    for (int i = 0; i < numNodes; i++)
+    {
+        nodes[i] = new Node(bus, i + 1);
+        nodes[i]->canMap.AddSend(Param::isaCurrent, 0x100 + i, 0, 16, 10);
+        nodes[i]->canMap.AddSend(Param::isaVoltage1, 0x100 + i, 16, 16, 10);
+        nodes[i]->canMap.AddSend(Param::isaTemperature, 0x100 + i, 32, 8, 1);
+    }
+    nodes[0]->canSdo.AddClient(&probe);
+
+    printf("%d nodes at 500 kbit/s, error rate %g\n\nBus load\n", numNodes, errorRate);
+
+    int sdoTarget = 1;
+
+    for (uint32_t step = 0; step < kDuration * 10; step++)
+    {
+        uint32_t ms = step / 10;
+
+        if (step % 10 == 0)
+        {
+            // Changing values change the stuff bits and with them the frame lengths
+            Param::SetFloat(Param::isaCurrent, (ms % 400) - 200.0f);
+            Param::SetFloat(Param::isaVoltage1, 350 + (ms % 37));
+            Param::SetFloat(Param::isaTemperature, 25 + (ms % 11));
+
+            if (ms % kSendPeriod == 0)
+            {
+                for (int i = 0; i < numNodes; i++)
+                    nodes[i]->canMap.SendAll();
+            }
+
+            if (ms % kSdoPeriod == 0)
+            {
+                probe.Request(nodes[0]->canSdo, sdoTarget + 1);
+                sdoTarget = sdoTarget + 1 < numNodes ? sdoTarget + 1 : 1;
+            }
+        }
+
+        bus.RunUntil((step + 1) * kStep);
+
+        for (int i = 0; i < numNodes; i++)
+            nodes[i]->hw.Poll();
+    }
+
+    printf("\nNode  id     tx     rx  errors dropped  queue  latency min/mean/max us\n");
+
+    for (int i = 0; i < numNodes; i++)
+    {
+        const CanHardwareSim::STATS& stats = nodes[i]->hw.GetStats();
+        double mean = stats.txFrames > 0 ? stats.latencySum / 1000.0 / stats.txFrames : 0;
+
+        printf("%4d 0x%03x %6u %6u %7u %7u %6u  %6.0f %6.0f %6.0f\n", i + 1, 0x100 + i,
+               stats.txFrames, stats.rxFrames, stats.txErrors, stats.txDropped, stats.maxQueued,
+               stats.txFrames > 0 ? stats.latencyMin / 1000.0 : 0, mean, stats.latencyMax / 1000.0);
+    }
+
+    const CanBusSim::STATS& busStats = bus.GetStats();
+
+    printf("\nBus: %u frames, %u error frames, mean load %.1f %%\n", busStats.frames, busStats.errorFrames,
+           busStats.busyTime * 100.0 / bus.GetTime());
+    probe.Report();
+
+    for (int i = 0; i < numNodes; i++)
+        delete nodes[i];
+    return 0;
+}
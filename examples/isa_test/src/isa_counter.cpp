@@ -0,0 +1,193 @@
+/*
+ * This file is part of the libopeninv-arduino ISA example.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <EEPROM.h>
+#include "isa_counter.h"
+#include "params.h"
+#include "crc32.h"
+
+// Fraction of the deviation from the sensor counters that is corrected per counter frame
+#define DRIFT_SHIFT 4
+// Frames further apart are treated as a gap in the data and not integrated
+#define MAX_GAP     1000 // ms
+// Largest rate of change of the sensor counters, a larger jump means the sensor was restarted
+#define MAX_AS_PER_S 2500 // A, measuring range of the IVT-S 2500
+#define MAX_WH_PER_S 695  // 2500 A at 1000 V
+
+// 2 x mA*ms per As and 2 x mV*mA*ms per Wh
+static const int64_t kChargePerAs = 2000000LL;
+static const int64_t kEnergyPerWh = 7200000000000LL;
+
+IsaCounter::IsaCounter()
+    : charge(0), energy(0), lastPower(0), lastCurrent(0), lastTime(0), haveSample(false),
+      chargeRef(0), energyRef(0), sensorAsRef(0), sensorWhRef(0), haveChargeRef(false),
+      haveEnergyRef(false), lastSensorAs(0), lastSensorWh(0), lastAsTime(0), lastWhTime(0), seq(0), lastSave(0), savedCharge(0), savedEnergy(0)
+{
+}
+
+/** \brief Restore the newest valid slot of the EEPROM ring */
+void IsaCounter::Load()
+{
+    for (int i = 0; i < ISA_COUNTER_SLOTS; i++)
+    {
+        Slot slot;
+        EEPROM.get(ISA_COUNTER_EEPROM_BASE + i * sizeof(Slot), slot);
+
+        if (slot.crc != crc32_block((uint32_t*)&slot, (sizeof(Slot) - 4) / 4)) continue;
+
+        if (slot.seq >= seq)
+        {
+            seq = slot.seq;
+            charge = savedCharge = slot.charge;
+            energy = savedEnergy = slot.energy;
+        }
+    }
+    haveChargeRef = haveEnergyRef = false;
+}
+
+void IsaCounter::Reset()
+{
+    charge = energy = 0;
+    haveChargeRef = haveEnergyRef = false;
+    Save();
+}
+
+/** \brief Update the integrals after CanMap has decoded an IVT frame
+ *
+ * \param id CAN id of the frame
+ * \param timestamp receive time in ms, CanHardware::GetLastRxTimestamp()
+ *
+ */
+void IsaCounter::HandleRx(uint32_t id, uint32_t timestamp)
+{
+    if (id == 0x521)
+    {
+        int32_t current = (int32_t)Param::GetFloat(Param::isaCurrent);           // mA
+        int64_t power = (int64_t)(int32_t)Param::GetFloat(Param::isaVoltage1) * current; // mV*mA
+
+        int32_t dt = timestamp - lastTime;
+
+        if (haveSample && dt <= MAX_GAP)
+        {
+            charge += (int64_t)(lastCurrent + current) * dt;
+            energy += (lastPower + power) * dt;
+        }
+
+        lastCurrent = current;
+        lastPower = power;
+        lastTime = timestamp;
+        haveSample = true;
+    }
+    else if (id == 0x527)
+    {
+        int32_t sensorAs = (int32_t)Param::GetFloat(Param::isaAh);
+        bool restart = !haveChargeRef || IsRestart(sensorAs, lastSensorAs, timestamp - lastAsTime, MAX_AS_PER_S);
+
+        // The counter is signed and falls while discharging, only a jump means it was restarted
+        lastSensorAs = sensorAs;
+        lastAsTime = timestamp;
+
+        if (restart)
+        {
+            sensorAsRef = sensorAs;
+            chargeRef = charge;
+            haveChargeRef = true;
+        }
+        else
+        {
+            int64_t error = (sensorAs - sensorAsRef) * kChargePerAs - (charge - chargeRef);
+            charge += error >> DRIFT_SHIFT;
+        }
+    }
+    else if (id == 0x528)
+    {
+        int32_t sensorWh = (int32_t)Param::GetFloat(Param::isaKWh);
+        bool restart = !haveEnergyRef || IsRestart(sensorWh, lastSensorWh, timestamp - lastWhTime, MAX_WH_PER_S);
+
+        lastSensorWh = sensorWh;
+        lastWhTime = timestamp;
+
+        if (restart)
+        {
+            sensorWhRef = sensorWh;
+            energyRef = energy;
+            haveEnergyRef = true;
+        }
+        else
+        {
+            int64_t error = (sensorWh - sensorWhRef) * kEnergyPerWh - (energy - energyRef);
+            energy += error >> DRIFT_SHIFT;
+        }
+    }
+}
+
+/** \brief Publish the results and save them once per ISA_COUNTER_SAVE_PERIOD when changed
+ *
+ * \param time current time in ms, e.g. millis()
+ *
+ */
+void IsaCounter::Task(uint32_t time)
+{
+    Param::SetFloat(Param::isaAhInt, GetAh());
+    Param::SetFloat(Param::isaKWhInt, GetKWh());
+
+    if ((time - lastSave) >= ISA_COUNTER_SAVE_PERIOD)
+    {
+        lastSave = time;
+
+        if (charge != savedCharge || energy != savedEnergy)
+            Save();
+    }
+}
+
+float IsaCounter::GetAh()
+{
+    return (float)charge / (kChargePerAs * 3600);
+}
+
+float IsaCounter::GetKWh()
+{
+    return (float)energy / (kEnergyPerWh * 1000);
+}
+
+/********* Private functions *******/
+
+// The counter changed by more than the largest current or power can cause since the last frame
+bool IsaCounter::IsRestart(int32_t value, int32_t last, uint32_t dt, int32_t maxPerSecond)
+{
+    int64_t step = (int64_t)value - last;
+    int64_t maxStep = (int64_t)maxPerSecond * dt / 1000 + 1;
+
+    return step > maxStep || step < -maxStep;
+}
+
+// Each save goes to the next slot, so every slot is only written every ISA_COUNTER_SLOTS saves
+void IsaCounter::Save()
+{
+    Slot slot;
+
+    seq++;
+    slot.seq = seq;
+    slot.charge = charge;
+    slot.energy = energy;
+    slot.crc = crc32_block((uint32_t*)&slot, (sizeof(Slot) - 4) / 4);
+
+    EEPROM.put(ISA_COUNTER_EEPROM_BASE + (seq % ISA_COUNTER_SLOTS) * sizeof(Slot), slot);
+    savedCharge = charge;
+    savedEnergy = energy;
+}
@@ -0,0 +1,82 @@
+/*
+ * This file is part of the libopeninv-arduino ISA example.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ISA_COUNTER_H
+#define ISA_COUNTER_H
+
+#include <stdint.h>
+
+// EEPROM area for the counter ring, after the CAN map
+#ifndef ISA_COUNTER_EEPROM_BASE
+#define ISA_COUNTER_EEPROM_BASE 3584
+#endif
+#define ISA_COUNTER_SLOTS       8
+#define ISA_COUNTER_SAVE_PERIOD 60000 // ms
+
+/*  Integrates charge and energy from the IVT current and voltage frames.
+    Call HandleRx() after CanMap has decoded a frame and Task() from loop().
+    Accumulators are 64-bit fixed point, twice the trapezoid area in mA*ms and mV*mA*ms,
+    so each frame only costs a few integer operations.
+    The sensor's own Ah/kWh counters slowly pull the result back to correct drift.
+ */
+class IsaCounter
+{
+public:
+    IsaCounter();
+    void Load();
+    void Reset();
+    void HandleRx(uint32_t id, uint32_t timestamp);
+    void Task(uint32_t time);
+    float GetAh();
+    float GetKWh();
+
+private:
+    struct Slot
+    {
+        uint32_t seq;
+        int64_t charge;
+        int64_t energy;
+        uint32_t crc;
+    } __attribute__((packed));
+
+    int64_t charge;
+    int64_t energy;
+    int64_t lastPower;
+    int32_t lastCurrent;
+    uint32_t lastTime;
+    bool haveSample;
+    int64_t chargeRef;
+    int64_t energyRef;
+    int32_t sensorAsRef;
+    int32_t sensorWhRef;
+    bool haveChargeRef;
+    bool haveEnergyRef;
+    int32_t lastSensorAs;
+    int32_t lastSensorWh;
+    uint32_t lastAsTime;
+    uint32_t lastWhTime;
+    uint32_t seq;
+    uint32_t lastSave;
+    int64_t savedCharge;
+    int64_t savedEnergy;
+
+    void Save();
+    static bool IsRestart(int32_t value, int32_t last, uint32_t dt, int32_t maxPerSecond);
+};
+
+#endif // ISA_COUNTER_H
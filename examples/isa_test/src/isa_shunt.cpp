@@ -13,90 +13,69 @@
 #include "my_math.h"
 #include "params.h"
 
-uint16_t  framecount=0;
 bool firstframe=true;
 
-
-
-
-#define FLASH_DELAY 8000000
-static void delay(void) //delay used for isa setup fumction. probably much better ways but its used only once.......
-{
-   int i;
-   for (i = 0; i < FLASH_DELAY; i++)       /* Wait a bit. */
-      __asm__("nop");
-}
-
-void ISA::DecodeCAN(int id, uint32_t data[2])
-{
-   switch (id)
-   {
-   case 0x521:
-      ISA::handle521(data);//ISA CAN MESSAGE
-      break;
-   case 0x522:
-      ISA::handle522(data);//ISA CAN MESSAGE
-      break;
-   case 0x523:
-      ISA::handle523(data);//ISA CAN MESSAGE
-      break;
-   case 0x524:
-      ISA::handle524(data);//ISA CAN MESSAGE
-      break;
-   case 0x525:
-      ISA::handle525(data);//ISA CAN MESSAGE
-      break;
-   case 0x526:
-      ISA::handle526(data);//ISA CAN MESSAGE
-      break;
-   case 0x527:
-      ISA::handle527(data);//ISA CAN MESSAGE
-      break;
-   case 0x528:
-      ISA::handle528(data);//ISA CAN MESSAGE
-      break;
-   }
-}
-
-void ISA::RegisterCanMessages(CanHardware* can)
-{
-   can->RegisterUserMessage(0x521);//ISA MSG
-   can->RegisterUserMessage(0x522);//ISA MSG
-   can->RegisterUserMessage(0x523);//ISA MSG
-   can->RegisterUserMessage(0x524);//ISA MSG
-   can->RegisterUserMessage(0x525);//ISA MSG
-   can->RegisterUserMessage(0x526);//ISA MSG
-   can->RegisterUserMessage(0x527);//ISA MSG
-   can->RegisterUserMessage(0x528);//ISA MSG
-}
-
-void ISA::initialize(CanHardware* can)
+//All IVT result messages carry a signed 32 bit little endian value in bytes 2..5
+//Needs CAN_SIGNED=1 for negative currents and power
+static const CanMap::PROFILEITEM isaProfile[] =
+{
+   //id     parameter              offset bits  gain
+   { 0x521, Param::isaCurrent,     16,    32,   1.0f,  0 }, //mA
+   { 0x522, Param::isaVoltage1,    16,    32,   1.0f,  0 }, //mV
+   { 0x523, Param::isaVoltage2,    16,    32,   1.0f,  0 }, //mV
+   { 0x524, Param::isaVoltage3,    16,    32,   1.0f,  0 }, //mV
+   { 0x525, Param::isaTemperature, 16,    32,   0.1f,  0 }, //0.1 degC
+   { 0x526, Param::isaKW,          16,    32,   1.0f,  0 }, //W
+   { 0x527, Param::isaAh,          16,    32,   1.0f,  0 }, //As
+   { 0x528, Param::isaKWh,         16,    32,   1.0f,  0 }, //Wh
+};
+
+#define ISA_CMD_ID   0x411
+#define ISA_DELAY    50 //ms between configuration commands
+
+#define ISA_START    { ISA_CMD_ID, { 0x34, 0x01, 0x01 }, 8, ISA_DELAY, 0, 0 }
+#define ISA_STORE    { ISA_CMD_ID, { 0x32 }, 8, ISA_DELAY, 0, 0 }
+//Result i cyclic with 100 ms
+#define ISA_CONFIG(i) { ISA_CMD_ID, { 0x20 + i, 0x42, 0x00, 0x64 }, 8, ISA_DELAY, 0, 0 }, ISA_STORE
+
+static const CanCommandSequence::STEP initSequence[] =
+{
+   { ISA_CMD_ID, { 0x34, 0x00, 0x01 }, 8, 0, 0, 0 }, //stop
+   ISA_CONFIG(0), ISA_CONFIG(1), ISA_CONFIG(2), ISA_CONFIG(3), ISA_CONFIG(4),
+   ISA_CONFIG(5), ISA_CONFIG(6), ISA_CONFIG(7), ISA_CONFIG(8),
+   ISA_START
+};
+
+static const CanCommandSequence::STEP initCurrentSequence[] =
+{
+   { ISA_CMD_ID, { 0x34, 0x00, 0x01 }, 8, 0, 0, 0 }, //stop
+   { ISA_CMD_ID, { 0x21, 0x42, 0x01, 0x61 }, 8, ISA_DELAY, 0, 0 },
+   ISA_STORE,
+   { ISA_CMD_ID, { 0x34, 0x01, 0x01 }, 8, 0, 0, 0 }, //start right after store
+};
+
+/** \brief Decode the IVT result messages with the given CAN map
+ *
+ * \param map CanMap that receives the messages
+ * \return number of mapped values or CAN_ERR_xx
+ *
+ */
+int ISA::AddToMap(CanMap* map)
+{
+   return map->AddRecvProfile(isaProfile, sizeof(isaProfile) / sizeof(isaProfile[0]));
+}
+
+/** \brief Start the configuration of all results with 100 ms cycle time
+ *
+ * \param seq sequencer that must be run from loop()
+ * \param time current time in ms, e.g. millis()
+ * \return true: started, false: sequencer busy
+ *
+ */
+bool ISA::initialize(CanCommandSequence* seq, uint32_t time)
 {
-   uint8_t bytes[8];
-
    firstframe=false;
-   STOP(can);
-   delay();
-   for(int i=0; i<9; i++)
-   {
-      bytes[0]=(0x20+i);
-      bytes[1]=0x42;
-      bytes[2]=0x00;
-      bytes[3]=0x64;
-      bytes[4]=0x00;
-      bytes[5]=0x00;
-      bytes[6]=0x00;
-      bytes[7]=0x00;
-
-      can->Send(0x411, (uint32_t*)bytes, 8);
-      delay();
-
-      sendSTORE(can);
-      delay();
-   }
-   START(can);
-   delay();
-
+   return seq->Start(initSequence, sizeof(initSequence) / sizeof(initSequence[0]), time);
 }
 
 void ISA::STOP(CanHardware* can)
@@ -190,99 +169,7 @@ void ISA::deFAULT(CanHardware* can)
 }
 
 
-void ISA::initCurrent(CanHardware* can)
-{
-   uint8_t bytes[8];
-   STOP(can);
-   delay();
-   bytes[0]=0x21;
-   bytes[1]=0x42;
-   bytes[2]=0x01;
-   bytes[3]=0x61;
-   bytes[4]=0x00;
-   bytes[5]=0x00;
-   bytes[6]=0x00;
-   bytes[7]=0x00;
-
-   can->Send(0x411, (uint32_t*)bytes,8);
-
-   delay();
-   sendSTORE(can);
-   START(can);
-   delay();
-
-}
-
-/********* Private functions *******/
-
-void ISA::handle521(uint32_t data[2])  //Amperes
-
+bool ISA::initCurrent(CanCommandSequence* seq, uint32_t time)
 {
-   uint8_t* bytes = (uint8_t*)data;// arrgghhh this converts the two 32bit array into bytes. See comments are useful:)
-   int32_t amperes = ((bytes[5] << 24) | (bytes[4] << 16) | (bytes[3] << 8) | (bytes[2]));
-   Param::SetFloat(Param::isaCurrent, static_cast<float>(amperes));
-}
-
-void ISA::handle522(uint32_t data[2])  //Voltage
-
-{
-   uint8_t* bytes = (uint8_t*)data;// arrgghhh this converts the two 32bit array into bytes. See comments are useful:)
-   int32_t voltage = ((bytes[5] << 24) | (bytes[4] << 16) | (bytes[3] << 8) | (bytes[2]));
-   Param::SetFloat(Param::isaVoltage1, static_cast<float>(voltage));
-}
-
-void ISA::handle523(uint32_t data[2]) //Voltage2
-
-{
-   uint8_t* bytes = (uint8_t*)data;// arrgghhh this converts the two 32bit array into bytes. See comments are useful:)
-   int32_t voltage2 = (uint32_t)((bytes[5] << 24) | (bytes[4] << 16) | (bytes[3] << 8) | (bytes[2]));
-   Param::SetFloat(Param::isaVoltage2, static_cast<float>(voltage2));
-
-
-}
-
-void ISA::handle524(uint32_t data[2])  //Voltage3
-
-{
-   uint8_t* bytes = (uint8_t*)data;// arrgghhh this converts the two 32bit array into bytes. See comments are useful:)
-   int32_t voltage3 = (uint32_t)((bytes[5] << 24) | (bytes[4] << 16) | (bytes[3] << 8) | (bytes[2]));
-   Param::SetFloat(Param::isaVoltage3, static_cast<float>(voltage3));
-
-}
-
-void ISA::handle525(uint32_t data[2])  //Temperature
-{
-   uint8_t* bytes = (uint8_t*)data;// arrgghhh this converts the two 32bit array into bytes. See comments are useful:)
-   framecount++;
-   int32_t temp=0;
-   temp = (int32_t)((bytes[5] << 24) | (bytes[4] << 16) | (bytes[3] << 8) | (bytes[2]));
-
-   temp = temp / 10;
-   Param::SetFloat(Param::isaTemperature, static_cast<float>(temp));
-
-}
-
-void ISA::handle526(uint32_t data[2]) //Kilowatts
-{
-   uint8_t* bytes = (uint8_t*)data;// arrgghhh this converts the two 32bit array into bytes. See comments are useful:)
-   int32_t kw = (int32_t)((bytes[5] << 24) | (bytes[4] << 16) | (bytes[3] << 8) | (bytes[2]));
-   Param::SetFloat(Param::isaKW, static_cast<float>(kw));
-}
-
-
-void ISA::handle527(uint32_t data[2]) //Ampere-Hours
-
-{
-   uint8_t* bytes = (uint8_t*)data;// arrgghhh this converts the two 32bit array into bytes. See comments are useful:)
-   int32_t ah = (bytes[5] << 24) | (bytes[4] << 16) | (bytes[3] << 8) | (bytes[2]);
-   Param::SetFloat(Param::isaAh, static_cast<float>(ah));
-}
-
-void ISA::handle528(uint32_t data[2])  //kiloWatt-hours
-
-{
-   uint8_t* bytes = (uint8_t*)data;// arrgghhh this converts the two 32bit array into bytes. See comments are useful:)
-   int32_t kwh = ((bytes[5] << 24) | (bytes[4] << 16) | (bytes[3] << 8) | (bytes[2]));
-   Param::SetFloat(Param::isaKWh, static_cast<float>(kwh));
-
+   return seq->Start(initCurrentSequence, sizeof(initCurrentSequence) / sizeof(initCurrentSequence[0]), time);
 }
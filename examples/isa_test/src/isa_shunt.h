@@ -11,6 +11,8 @@
 #include <stdint.h>
 #include "my_fp.h"
 #include "canhardware.h"
+#include "canmap.h"
+#include "cancommandseq.h"
 
 class ISA
 {
@@ -19,25 +21,14 @@ class ISA
     ~ISA();
 
 public:
-    static void RegisterCanMessages(CanHardware* can);
-    static void initialize(CanHardware* can);
-    static void initCurrent(CanHardware* can);
+    static int AddToMap(CanMap* map);
+    static bool initialize(CanCommandSequence* seq, uint32_t time);
+    static bool initCurrent(CanCommandSequence* seq, uint32_t time);
     static void sendSTORE(CanHardware* can);
     static void STOP(CanHardware* can);
     static void START(CanHardware* can);
     static void RESTART(CanHardware* can);
     static void deFAULT(CanHardware* can);
-    static void DecodeCAN(int id, uint32_t data[2]);
-
-private:
-    static void handle521(uint32_t data[2]);
-    static void handle522(uint32_t data[2]);
-    static void handle523(uint32_t data[2]);
-    static void handle524(uint32_t data[2]);
-    static void handle525(uint32_t data[2]);
-    static void handle526(uint32_t data[2]);
-    static void handle527(uint32_t data[2]);
-    static void handle528(uint32_t data[2]);
 };
 
 #endif /* SimpleISA_h */
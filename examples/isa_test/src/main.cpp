@@ -1,23 +1,31 @@
 #include <Arduino.h>
 #include <ACAN_T4.h>
 #include "canhardware_teensy41.h"
+#include "canmap.h"
+#include "cancommandseq.h"
 #include "isa_shunt.h"
+#include "isa_counter.h"
 #include "params.h"
 
 static const uint32_t kPrintPeriodMs = 1000;
 
 CanHardwareTeensy41 canHardware(CanHardwareTeensy41::Can1, CanHardware::Baud500);
+CanMap canMap(&canHardware, false);
+CanCommandSequence isaSequence(&canHardware);
+IsaCounter isaCounter;
 
 static bool Can1Callback(uint32_t id, uint32_t *data, uint8_t dlc)
 {
-    (void)dlc;
-    ISA::DecodeCAN(id, data);
+    canMap.HandleRx(id, data, dlc);
+    isaCounter.HandleRx(id, canHardware.GetLastRxTimestamp());
+    isaSequence.HandleRx(id, data, dlc);
     return true;
 }
 
 static void SetCanFilters()
 {
-    ISA::RegisterCanMessages(&canHardware);
+    canMap.HandleClear();
+    isaSequence.HandleClear();
 }
 
 static FunctionPointerCallback isaCallback(Can1Callback, SetCanFilters);
@@ -29,11 +37,12 @@ void setup()
 
     Serial.println("\n=== ISA IVT Test (Teensy 4.1) ===");
 
+    isaCounter.Load();
     canHardware.AddCallback(&isaCallback);
-    ISA::RegisterCanMessages(&canHardware);
+    ISA::AddToMap(&canMap);
 
     Serial.println("Listening for ISA IVT frames 0x521-0x528");
-    Serial.println("Send 'i' to initialize, 'c' to init current, 'r' to restart");
+    Serial.println("Send 'i' to initialize, 'c' to init current, 'r' to restart, 'z' to zero the counters");
 }
 
 void loop()
@@ -45,21 +54,38 @@ void loop()
         const char cmd = static_cast<char>(Serial.read());
         if (cmd == 'i' || cmd == 'I')
         {
-            ISA::initialize(&canHardware);
-            Serial.println("ISA initialize sequence sent");
+            if (ISA::initialize(&isaSequence, millis()))
+                Serial.println("ISA initialize sequence started");
         }
         else if (cmd == 'c' || cmd == 'C')
         {
-            ISA::initCurrent(&canHardware);
-            Serial.println("ISA current calibration sent");
+            if (ISA::initCurrent(&isaSequence, millis()))
+                Serial.println("ISA current calibration started");
         }
         else if (cmd == 'r' || cmd == 'R')
         {
             ISA::RESTART(&canHardware);
             Serial.println("ISA restart sent");
         }
+        else if (cmd == 'z' || cmd == 'Z')
+        {
+            isaCounter.Reset();
+            Serial.println("Integrated Ah/kWh reset");
+        }
+    }
+
+    // Configuration frames are sent from here, CAN reception keeps running in between
+    if (isaSequence.IsBusy())
+    {
+        const CanCommandSequence::states state = isaSequence.Run(millis());
+        if (state == CanCommandSequence::Done)
+            Serial.println("ISA sequence done");
+        else if (state == CanCommandSequence::Failed)
+            Serial.println("ISA sequence failed");
     }
 
+    isaCounter.Task(millis());
+
     static uint32_t lastPrint = 0;
     if (millis() - lastPrint >= kPrintPeriodMs)
     {
@@ -79,6 +105,10 @@ void loop()
         Serial.print(" kW=");
         Serial.print(Param::GetFloat(Param::isaKW));
         Serial.print(" kWh=");
-        Serial.println(Param::GetFloat(Param::isaKWh));
+        Serial.print(Param::GetFloat(Param::isaKWh));
+        Serial.print(" Ah(int)=");
+        Serial.print(Param::GetFloat(Param::isaAhInt), 4);
+        Serial.print(" kWh(int)=");
+        Serial.println(Param::GetFloat(Param::isaKWhInt), 4);
     }
 }
@@ -0,0 +1,356 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*  Host test of the Provisioner on a simulated bus.
+    Node 1 copies the CAN map of master node 2 to nodes 3 to 6:
+    - the reply of node 3 to the sub index 2 of its first map item is lost, the item
+      may be in the map already, so it is written again from sub index 0
+    - node 4 starts with a different map that has to be cleared
+    - node 5 already has the map of the master and is left alone
+    - node 6 stalls for a while after the sub index 2 of its first map item, its late
+      replies must not be taken for replies to the requests sent again
+    This runs once with one request in flight per node and once with a window of 4.
+    A last run writes an image whose second item names a value the targets do not know;
+    the pipelined sub index 2 of that item must not add anything to their maps.
+    Build with "pio run -e native_provision_sim" and run .pio/build/native_provision_sim/program,
+    it returns 0 when every target ends up with the map of the master.
+    All nodes share the parameters of this process, so only the maps differ between them,
+    see README "Bus Simulation".
+ */
+#include <stdio.h>
+#include "canbussim.h"
+#include "canmap.h"
+#include "cansdo.h"
+#include "provisioner.h"
+
+static const uint64_t kStep = 100000; // 100 us in ns
+static const uint32_t kMaxTime = 5000; // ms
+static const uint32_t kStall = 30;    // ms, longer than the provisioner timeout
+static const uint16_t kTimeout = 20;  // ms
+
+// CanMap inherits CanCallback privately, this passes the frames on
+template <class T>
+class CanForward: public CanCallback
+{
+    public:
+        explicit CanForward(T& target) : target(target) {}
+        void HandleRx(uint32_t canId, uint32_t data[2], uint8_t dlc) override { target.HandleRx(canId, data, dlc); }
+        void HandleClear() override { target.HandleClear(); }
+
+    private:
+        T& target;
+};
+
+// Passes frames to the CanSdo of a node. The fault hits the first frame with the given id
+// that carries sub index 2 of a map item. Drop loses it like an overrun receive buffer,
+// Stall holds it and all following frames for a while like a node busy writing its flash.
+class FaultySdo: public CanCallback
+{
+    public:
+        enum faults { NoFault, Drop, Stall };
+
+        FaultySdo(CanSdo& sdo)
+            : sdo(sdo), canId(0), fault(NoFault), hit(false), until(0), now(0), numHeld(0) {}
+
+        void SetFault(uint32_t id, enum faults f) { canId = id; fault = f; }
+
+        void HandleRx(uint32_t id, uint32_t data[2], uint8_t dlc) override
+        {
+            const SdoServer::SdoFrame* frame = (const SdoServer::SdoFrame*)data;
+
+            if (!hit && fault != NoFault && id == canId && frame->index == SDO_INDEX_MAP_TX && frame->subIndex == 2)
+            {
+                hit = true;
+                until = now + kStall;
+
+                if (fault == Drop) return;
+            }
+
+            if (fault == Stall && hit && now < until)
+            {
+                if (numHeld < kMaxHeld)
+                {
+                    held[numHeld].canId = id;
+                    held[numHeld].data[0] = data[0];
+                    held[numHeld].data[1] = data[1];
+                    held[numHeld].dlc = dlc;
+                    numHeld++;
+                }
+                return;
+            }
+            sdo.HandleRx(id, data, dlc);
+        }
+
+        void HandleClear() override { sdo.HandleClear(); }
+
+        void Task(uint32_t time)
+        {
+            now = time;
+
+            if (numHeld == 0 || now < until) return;
+
+            for (int i = 0; i < numHeld; i++)
+                sdo.HandleRx(held[i].canId, held[i].data, held[i].dlc);
+            numHeld = 0;
+        }
+
+        bool IsHit() { return hit; }
+
+    private:
+        static const int kMaxHeld = 16;
+
+        struct FRAME
+        {
+            uint32_t canId;
+            uint32_t data[2];
+            uint8_t dlc;
+        };
+
+        CanSdo& sdo;
+        uint32_t canId;
+        enum faults fault;
+        bool hit;
+        uint32_t until;
+        uint32_t now;
+        FRAME held[kMaxHeld];
+        int numHeld;
+};
+
+struct Node
+{
+    CanHardwareSim hw;
+    CanMap canMap;
+    CanSdo canSdo;
+    CanForward<CanMap> mapCallback;
+    FaultySdo sdoCallback;
+
+    Node(CanBusSim& bus, uint8_t nodeId)
+        : hw(bus), canMap(&hw, false), canSdo(&hw, &canMap), mapCallback(canMap), sdoCallback(canSdo)
+    {
+        canSdo.SetNodeId(nodeId);
+        hw.AddCallback(&mapCallback);
+        hw.AddCallback(&sdoCallback);
+    }
+};
+
+static void AddMasterMap(CanMap& canMap)
+{
+    canMap.AddSend(Param::isaCurrent, 0x180, 0, 16, 10);
+    canMap.AddSend(Param::isaVoltage1, 0x180, 16, 16, 10);
+    canMap.AddSend(Param::isaTemperature, 0x180, 32, 8, 1);
+    canMap.AddSend(Param::isaKW, 0x181, 0, 32, 1000);
+    canMap.AddRecv(Param::BMS_Vmin, 0x200, 0, 16, 0.001f);
+    canMap.AddRecv(Param::BMS_Vmax, 0x200, 16, 16, 0.001f);
+}
+
+// Same items in the same order
+static bool SameMap(CanMap& a, CanMap& b)
+{
+    for (int rx = 0; rx < 2; rx++)
+    {
+        for (int msg = 0; msg < MAX_MESSAGES; msg++)
+        {
+            for (int item = 0; ; item++)
+            {
+                uint32_t idA = 0, idB = 0;
+                const CanMap::CANPOS* posA = a.GetMap(rx, msg, item, idA);
+                const CanMap::CANPOS* posB = b.GetMap(rx, msg, item, idB);
+
+                if (posA == 0 && posB == 0) break;
+                if (posA == 0 || posB == 0 || idA != idB) return false;
+                if (SdoServer::MapItemWord(posA) != SdoServer::MapItemWord(posB)) return false;
+                if (SdoServer::MapGainWord(posA) != SdoServer::MapGainWord(posB)) return false;
+            }
+        }
+    }
+    return true;
+}
+
+static int CountItems(CanMap& canMap)
+{
+    int count = 0;
+
+    for (int rx = 0; rx < 2; rx++)
+    {
+        for (int msg = 0; msg < MAX_MESSAGES; msg++)
+        {
+            uint32_t canId;
+
+            for (int item = 0; canMap.GetMap(rx, msg, item, canId) != 0; item++)
+                count++;
+        }
+    }
+    return count;
+}
+
+static bool Provision(uint8_t window)
+{
+    static const uint8_t targets[] = { 3, 4, 5, 6 };
+    static const Provisioner::nodestates expected[] = { Provisioner::NodeDone, Provisioner::NodeDone,
+                                                        Provisioner::NodeUnchanged, Provisioner::NodeDone };
+    static const char* stateNames[] = { "busy", "done", "unchanged", "failed" };
+    static const uint16_t skipIds[] = { 1 }; // node id
+    const int numTargets = sizeof(targets) / sizeof(targets[0]);
+    CanBusSim bus(CanHardware::Baud500);
+    Node* nodes[7];
+
+    for (int id = 1; id <= 6; id++)
+        nodes[id] = new Node(bus, id);
+
+    AddMasterMap(nodes[2]->canMap);
+    AddMasterMap(nodes[5]->canMap);
+    nodes[4]->canMap.AddSend(Param::isaAh, 0x180, 0, 32, 1);
+    nodes[1]->sdoCallback.SetFault(0x583, FaultySdo::Drop);
+    nodes[6]->sdoCallback.SetFault(0x606, FaultySdo::Stall);
+
+    Provisioner provisioner(&nodes[1]->canSdo);
+    uint32_t time = 0;
+
+    provisioner.SetSkip(skipIds, 1);
+    provisioner.SetWindow(window);
+    provisioner.SetTimeout(kTimeout);
+    provisioner.SetRetries(3);
+    provisioner.Start(2, targets, numTargets, time);
+
+    while (time < kMaxTime && provisioner.Run(time) != Provisioner::Done && provisioner.GetState() != Provisioner::Failed)
+    {
+        for (int i = 0; i < 10; i++)
+        {
+            bus.RunUntil(((uint64_t)time * 10 + i + 1) * kStep);
+
+            for (int id = 1; id <= 6; id++)
+            {
+                nodes[id]->sdoCallback.Task(time);
+                nodes[id]->hw.Poll();
+            }
+        }
+        time++;
+    }
+
+    bool ok = provisioner.GetState() == Provisioner::Done && nodes[1]->sdoCallback.IsHit() && nodes[6]->sdoCallback.IsHit();
+
+    printf("Window %d: provisioning %s after %u ms, %u frames on the bus\n", window,
+           provisioner.GetState() == Provisioner::Done ? "done" : "failed", time, bus.GetStats().frames);
+
+    for (int i = 0; i < numTargets; i++)
+    {
+        Node* node = nodes[targets[i]];
+        Provisioner::nodestates state = provisioner.GetNodeState(i);
+        bool match = SameMap(node->canMap, nodes[2]->canMap);
+        bool pass = state == expected[i] && match;
+
+        printf("node %d: %-9s %d items, map %s %s\n", targets[i], stateNames[state], CountItems(node->canMap),
+               match ? "matches" : "differs", pass ? "PASS" : "FAIL");
+        ok &= pass;
+    }
+
+    for (int id = 1; id <= 6; id++)
+        delete nodes[id];
+
+    return ok;
+}
+
+// All items refer to known values
+static bool ValidMap(CanMap& canMap)
+{
+    for (int rx = 0; rx < 2; rx++)
+    {
+        for (int msg = 0; msg < MAX_MESSAGES; msg++)
+        {
+            uint32_t canId;
+            const CanMap::CANPOS* pos;
+
+            for (int item = 0; (pos = canMap.GetMap(rx, msg, item, canId)) != 0; item++)
+            {
+                if (pos->mapParam >= Param::PARAM_LAST) return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool ProvisionUnknownValue()
+{
+    static const uint8_t targets[] = { 3, 4 };
+    CanBusSim bus(CanHardware::Baud500);
+    Node* nodes[5];
+
+    for (int id = 1; id <= 4; id++)
+        nodes[id] = new Node(bus, id);
+
+    AddMasterMap(nodes[2]->canMap);
+
+    Provisioner provisioner(&nodes[1]->canSdo);
+    Provisioner::IMAGE* image = new Provisioner::IMAGE;
+    uint32_t time = 0;
+
+    provisioner.LoadLocal(&nodes[2]->canMap);
+    *image = provisioner.GetImage();
+    image->maps[1].item = (image->maps[1].item & 0xFFFF0000) | 0x7777;
+    provisioner.SetImage(*image);
+    delete image;
+
+    provisioner.SetWindow(4);
+    provisioner.SetTimeout(kTimeout);
+    provisioner.SetRetries(1);
+    provisioner.Start(0, targets, 2, time);
+
+    while (time < kMaxTime && provisioner.Run(time) != Provisioner::Done && provisioner.GetState() != Provisioner::Failed)
+    {
+        for (int i = 0; i < 10; i++)
+        {
+            bus.RunUntil(((uint64_t)time * 10 + i + 1) * kStep);
+
+            for (int id = 1; id <= 4; id++)
+                nodes[id]->hw.Poll();
+        }
+        time++;
+    }
+
+    bool ok = provisioner.GetState() == Provisioner::Failed;
+
+    printf("Unknown value: provisioning %s after %u ms\n",
+           provisioner.GetState() == Provisioner::Failed ? "failed" : "did not fail", time);
+
+    for (int i = 0; i < 2; i++)
+    {
+        Node* node = nodes[targets[i]];
+        bool valid = ValidMap(node->canMap);
+        bool pass = provisioner.GetNodeState(i) == Provisioner::NodeFailed && valid;
+
+        printf("node %d: %d items, %s %s\n", targets[i], CountItems(node->canMap),
+               valid ? "all known" : "unknown value mapped", pass ? "PASS" : "FAIL");
+        ok &= pass;
+    }
+
+    for (int id = 1; id <= 4; id++)
+        delete nodes[id];
+
+    return ok;
+}
+
+int main()
+{
+    bool ok = Provision(1);
+
+    ok &= Provision(4);
+    ok &= ProvisionUnknownValue();
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -5,12 +5,14 @@
 #include "param_save.h"
 #include "cansdo.h"
 #include "canmap.h"
+#include "console.h"
 
 static const uint32_t kCanBitrate = 500000;
 
 CanHardwareTeensy41 canHardware(CanHardwareTeensy41::Can1);
 CanMap canMap(&canHardware);
 CanSdo canSdo(&canHardware, &canMap);
+Console console(Serial, canSdo);
 
 static bool Can1Callback(uint32_t canId, uint32_t data[2], uint8_t dlc)
 {
@@ -80,6 +82,7 @@ void setup()
 void loop()
 {
     canHardware.Poll();
+    canSdo.Task(millis());
 
     static unsigned long lastSend = 0;
     if (millis() - lastSend >= 100)
@@ -98,36 +101,6 @@ void loop()
         canMap.SendAll();
     }
 
-    if (Serial.available())
-    {
-        char cmd = Serial.read();
-
-        if (cmd == 's' || cmd == 'S')
-        {
-            Serial.println("Saving parameters to EEPROM...");
-            uint32_t crc = parm_save();
-            Serial.print("Saved with CRC: 0x");
-            Serial.println(crc, HEX);
-        }
-        else if (cmd == 'l' || cmd == 'L')
-        {
-            Serial.println("Loading parameters from EEPROM...");
-            if (parm_load() == 0)
-                Serial.println("Parameters loaded successfully");
-            else
-                Serial.println("Failed to load parameters (CRC error)");
-        }
-        else if (cmd == 'p' || cmd == 'P')
-        {
-            Serial.println("\nCurrent Parameters:");
-            Serial.print("  CAN Node ID: ");
-            Serial.println(Param::GetInt(Param::canNodeId));
-            Serial.print("  Pack Voltage: ");
-            Serial.print(Param::GetFloat(Param::packVoltage));
-            Serial.println(" V");
-            Serial.print("  Pack Current: ");
-            Serial.print(Param::GetFloat(Param::packCurrent));
-            Serial.println(" A");
-        }
-    }
+    // get/set/save/json/stream commands, e.g. "get packVoltage"
+    console.Task(millis());
 }
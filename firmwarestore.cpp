@@ -0,0 +1,125 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "firmwarestore.h"
+
+#ifdef FIRMWARE_HAVE_FLASHERX
+#include <string.h>
+extern "C" {
+#include "FlashTxx.h"
+}
+
+FlasherXStore::FlasherXStore()
+ : bufferAddr(0), bufferSize(0), erased(0)
+{
+}
+
+//The buffer is everything between the program and the EEPROM emulation
+bool FlasherXStore::Init()
+{
+   if (bufferAddr == 0 && firmware_buffer_init(&bufferAddr, &bufferSize) == 0)
+      bufferAddr = bufferSize = 0;
+
+   return bufferAddr != 0;
+}
+
+uint32_t FlasherXStore::GetCapacity()
+{
+   return Init() ? bufferSize : 0;
+}
+
+bool FlasherXStore::Begin(uint32_t size)
+{
+   erased = 0;
+   return Init() && size <= bufferSize;
+}
+
+bool FlasherXStore::Write(uint32_t offset, const uint8_t* data, uint32_t len)
+{
+   if (!IN_FLASH(bufferAddr))
+   {
+      memcpy((void*)(uintptr_t)(bufferAddr + offset), data, len);
+      return true;
+   }
+
+   //Erasing a sector takes a while, so only erase what is needed next
+   while (erased < offset + len)
+   {
+      if (flash_erase_block(bufferAddr + erased, FLASH_SECTOR_SIZE) != 0) return false;
+      erased += FLASH_SECTOR_SIZE;
+   }
+
+   return flash_write_block(bufferAddr + offset, (char*)data, len) == 0;
+}
+
+bool FlasherXStore::Commit(uint32_t size)
+{
+   //Refuse images built for another board
+   if (!check_flash_id(bufferAddr, size)) return false;
+
+   flash_move(FLASH_BASE_ADDR, bufferAddr, size);
+   return true;
+}
+#endif // FIRMWARE_HAVE_FLASHERX
+
+#ifndef ARDUINO
+/** \brief Firmware store in a file
+ *
+ * \param stagingPath file the image is written to
+ * \param targetPath the staged file is renamed to this on commit
+ * \param capacity maximum image size
+ *
+ */
+FileFirmwareStore::FileFirmwareStore(const char* stagingPath, const char* targetPath, uint32_t capacity)
+ : stagingPath(stagingPath), targetPath(targetPath), capacity(capacity), file(nullptr)
+{
+}
+
+FileFirmwareStore::~FileFirmwareStore()
+{
+   if (file != nullptr)
+      fclose(file);
+}
+
+bool FileFirmwareStore::Begin(uint32_t size)
+{
+   if (file != nullptr)
+      fclose(file);
+
+   file = fopen(stagingPath, "wb");
+   return file != nullptr && size <= capacity;
+}
+
+bool FileFirmwareStore::Write(uint32_t offset, const uint8_t* data, uint32_t len)
+{
+   if (file == nullptr || fseek(file, offset, SEEK_SET) != 0) return false;
+
+   return fwrite(data, 1, len, file) == len;
+}
+
+bool FileFirmwareStore::Commit(uint32_t size)
+{
+   if (file == nullptr) return false;
+
+   bool ok = fflush(file) == 0 && ftell(file) == (long)size;
+
+   fclose(file);
+   file = nullptr;
+   return ok && rename(stagingPath, targetPath) == 0;
+}
+#endif // ARDUINO
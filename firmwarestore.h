@@ -0,0 +1,76 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef FIRMWARESTORE_H
+#define FIRMWARESTORE_H
+#include "firmwareupdate.h"
+
+#if defined(ARDUINO) && defined(__has_include)
+#if __has_include("FlashTxx.h")
+#define FIRMWARE_HAVE_FLASHERX
+#endif
+#endif
+
+#ifdef FIRMWARE_HAVE_FLASHERX
+/* Stages the image in the free flash above the program with FlasherX, add FlashTxx.h
+   and FlashTxx.c to the project to enable it. The image is a raw binary starting at
+   FLASH_BASE_ADDR. Flash sectors are erased as the data arrives.
+ */
+class FlasherXStore: public FirmwareStore
+{
+   public:
+      FlasherXStore();
+      uint32_t GetCapacity() override;
+      bool Begin(uint32_t size) override;
+      bool Write(uint32_t offset, const uint8_t* data, uint32_t len) override;
+      bool Commit(uint32_t size) override;
+
+   private:
+      uint32_t bufferAddr;
+      uint32_t bufferSize;
+      uint32_t erased;   //bytes of the buffer that are erased
+
+      bool Init();
+};
+#endif // FIRMWARE_HAVE_FLASHERX
+
+#ifndef ARDUINO
+#include <stdio.h>
+
+/* Host build only: stages the image in a file. Commit renames it to the target
+   file, e.g. the image a simulated node is started from.
+ */
+class FileFirmwareStore: public FirmwareStore
+{
+   public:
+      FileFirmwareStore(const char* stagingPath, const char* targetPath, uint32_t capacity);
+      ~FileFirmwareStore();
+      uint32_t GetCapacity() override { return capacity; }
+      bool Begin(uint32_t size) override;
+      bool Write(uint32_t offset, const uint8_t* data, uint32_t len) override;
+      bool Commit(uint32_t size) override;
+
+   private:
+      const char* stagingPath;
+      const char* targetPath;
+      uint32_t capacity;
+      FILE* file;
+};
+#endif // ARDUINO
+
+#endif // FIRMWARESTORE_H
@@ -0,0 +1,192 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "firmwareupdate.h"
+#include "crc32.h"
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+/** \brief Add the firmware update objects to server
+ *
+ * \param server object dictionary, e.g. CanSdo
+ * \param store staging area of the image
+ *
+ */
+FirmwareUpdate::FirmwareUpdate(SdoServer& server, FirmwareStore& store)
+ : server(server), store(store), size(0), received(0), written(0), crc(CRC32_INIT), expectedCrc(0),
+   expectedCrcValid(false), status(FwIdle), chunkLen(0)
+{
+   server.RegisterObject({ SDO_INDEX_PROGRAM_DATA, SDO_INDEX_PROGRAM_DATA, SDO_ACCESS_WRITE, nullptr, WriteProgram, this });
+   server.RegisterObject({ SDO_INDEX_PROGRAM_CONTROL, SDO_INDEX_PROGRAM_CONTROL, SDO_ACCESS_WRITE, nullptr, WriteControl, this });
+   server.RegisterObject({ SDO_INDEX_PROGRAM_IDENT, SDO_INDEX_PROGRAM_IDENT, SDO_ACCESS_RW, ReadIdent, WriteIdent, this });
+   server.RegisterObject({ SDO_INDEX_FLASH_STATUS, SDO_INDEX_FLASH_STATUS, SDO_ACCESS_READ, ReadStatus, nullptr, this });
+}
+
+/** \brief Install a verified image, call from loop().
+ * This runs after the reply to the start command has been sent
+ */
+void FirmwareUpdate::Task()
+{
+   if (status != FwInstalling) return;
+
+   if (store.Commit(size))
+   {
+      status = FwInstalled;
+      #ifdef ARDUINO
+      NVIC_SystemReset();
+      #endif
+   }
+   else
+   {
+      status = FwWriteError;
+   }
+}
+
+bool FirmwareUpdate::Flush()
+{
+   bool ok = store.Write(written, chunk, chunkLen);
+
+   written += chunkLen;
+   chunkLen = 0;
+   return ok;
+}
+
+//Called by SdoServer for every segment of the block download
+size_t FirmwareUpdate::WriteData(void* context, const uint8_t* data, size_t len)
+{
+   FirmwareUpdate* update = (FirmwareUpdate*)context;
+
+   if (update->status != FwDownloading || len > update->size - update->received) return 0;
+
+   update->crc = crc32_bytes(update->crc, data, len);
+   update->received += len;
+
+   for (size_t i = 0; i < len; i++)
+   {
+      update->chunk[update->chunkLen++] = data[i];
+
+      if (update->chunkLen == FW_WRITE_CHUNK && !update->Flush())
+      {
+         update->status = FwWriteError;
+         return 0;
+      }
+   }
+
+   if (update->received == update->size)
+   {
+      if (update->chunkLen > 0 && !update->Flush())
+      {
+         update->status = FwWriteError;
+         return 0;
+      }
+      update->status = FwReceived;
+   }
+   return len;
+}
+
+//Initiation of the block download, data is the image size
+uint32_t FirmwareUpdate::WriteProgram(void* context, uint16_t, uint8_t subIndex, uint32_t data)
+{
+   FirmwareUpdate* update = (FirmwareUpdate*)context;
+
+   if (subIndex != 1) return SDO_ERR_INVIDX;
+   if (update->status == FwInstalling) return SDO_ERR_GENERAL;
+
+   if (data == 0 || data > update->store.GetCapacity())
+   {
+      update->status = FwSizeError;
+      return SDO_ERR_RANGE;
+   }
+
+   if (!update->store.Begin(data))
+   {
+      update->status = FwWriteError;
+      return SDO_ERR_STORE;
+   }
+
+   update->size = data;
+   update->received = 0;
+   update->written = 0;
+   update->chunkLen = 0;
+   update->crc = CRC32_INIT;
+   update->status = FwDownloading;
+   update->server.BeginDownload(WriteData, update);
+   return SDO_SEGMENTED;
+}
+
+uint32_t FirmwareUpdate::WriteControl(void* context, uint16_t, uint8_t subIndex, uint32_t data)
+{
+   FirmwareUpdate* update = (FirmwareUpdate*)context;
+
+   if (subIndex != 1) return SDO_ERR_INVIDX;
+
+   switch (data)
+   {
+   case FW_CONTROL_STOP:
+   case FW_CONTROL_CLEAR:
+      if (update->status == FwInstalling) return SDO_ERR_GENERAL;
+      update->status = FwIdle;
+      update->expectedCrcValid = false;
+      return SDO_OK;
+   case FW_CONTROL_START:
+      if (update->status != FwReceived) return SDO_ERR_GENERAL;
+
+      if (!update->expectedCrcValid || ~update->crc != update->expectedCrc)
+      {
+         update->status = FwCrcError;
+         return SDO_ERR_CRC;
+      }
+      update->status = FwInstalling;
+      return SDO_OK;
+   default:
+      return SDO_ERR_RANGE;
+   }
+}
+
+//CRC-32 of the received image, same as zlib crc32()
+uint32_t FirmwareUpdate::ReadIdent(void* context, uint16_t, uint8_t subIndex, uint32_t& data)
+{
+   FirmwareUpdate* update = (FirmwareUpdate*)context;
+
+   if (subIndex != 1) return SDO_ERR_INVIDX;
+
+   data = ~update->crc;
+   return SDO_OK;
+}
+
+uint32_t FirmwareUpdate::WriteIdent(void* context, uint16_t, uint8_t subIndex, uint32_t data)
+{
+   FirmwareUpdate* update = (FirmwareUpdate*)context;
+
+   if (subIndex != 1) return SDO_ERR_INVIDX;
+
+   update->expectedCrc = data;
+   update->expectedCrcValid = true;
+   return SDO_OK;
+}
+
+uint32_t FirmwareUpdate::ReadStatus(void* context, uint16_t, uint8_t subIndex, uint32_t& data)
+{
+   FirmwareUpdate* update = (FirmwareUpdate*)context;
+
+   if (subIndex != 1) return SDO_ERR_INVIDX;
+
+   data = update->status;
+   return SDO_OK;
+}
@@ -0,0 +1,98 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef FIRMWAREUPDATE_H
+#define FIRMWAREUPDATE_H
+#include "sdoserver.h"
+
+#define SDO_INDEX_PROGRAM_DATA    0x1F50
+#define SDO_INDEX_PROGRAM_CONTROL 0x1F51
+#define SDO_INDEX_PROGRAM_IDENT   0x1F56
+#define SDO_INDEX_FLASH_STATUS    0x1F57
+
+//Values of 0x1F51
+#define FW_CONTROL_STOP           0
+#define FW_CONTROL_START          1 //install the received image and reboot
+#define FW_CONTROL_CLEAR          3
+
+//Data is collected and written to the store in chunks of this size
+#ifndef FW_WRITE_CHUNK
+#define FW_WRITE_CHUNK            256
+#endif
+
+/* Staging area for a new firmware image, see firmwarestore.h */
+class FirmwareStore
+{
+   public:
+      virtual uint32_t GetCapacity() = 0;
+      //Prepare the staging area for an image of size bytes
+      virtual bool Begin(uint32_t size) = 0;
+      virtual bool Write(uint32_t offset, const uint8_t* data, uint32_t len) = 0;
+      //Install the staged image, need not return if it reboots by itself
+      virtual bool Commit(uint32_t size) = 0;
+};
+
+/* Firmware update objects as in CiA 302:
+   0x1F50 sub 1 takes the image as SDO block download into the store.
+   0x1F56 sub 1 reads the CRC-32 of the received image, the client writes the CRC-32
+   it expects before starting.
+   0x1F57 sub 1 reads the status below.
+   Writing 1 to 0x1F51 sub 1 checks the CRC, installs the image and reboots from Task().
+ */
+class FirmwareUpdate
+{
+   public:
+      enum status
+      {
+         FwIdle,
+         FwDownloading,
+         FwReceived,
+         FwInstalling,
+         FwInstalled,   //only seen when the store does not reboot, e.g. on the host
+         FwCrcError,
+         FwWriteError,
+         FwSizeError
+      };
+
+      FirmwareUpdate(SdoServer& server, FirmwareStore& store);
+      void Task();
+      enum status GetStatus() { return (enum status)status; }
+
+   private:
+      SdoServer& server;
+      FirmwareStore& store;
+      uint32_t size;
+      uint32_t received;
+      uint32_t written;
+      uint32_t crc;
+      uint32_t expectedCrc;
+      bool expectedCrcValid;
+      uint8_t status;
+      uint16_t chunkLen;
+      uint8_t chunk[FW_WRITE_CHUNK];
+
+      bool Flush();
+      static size_t WriteData(void* context, const uint8_t* data, size_t len);
+      static uint32_t WriteProgram(void* context, uint16_t index, uint8_t subIndex, uint32_t data);
+      static uint32_t WriteControl(void* context, uint16_t index, uint8_t subIndex, uint32_t data);
+      static uint32_t ReadIdent(void* context, uint16_t index, uint8_t subIndex, uint32_t& data);
+      static uint32_t WriteIdent(void* context, uint16_t index, uint8_t subIndex, uint32_t data);
+      static uint32_t ReadStatus(void* context, uint16_t index, uint8_t subIndex, uint32_t& data);
+};
+
+#endif // FIRMWAREUPDATE_H
@@ -0,0 +1,31 @@
+#ifndef ERRORMESSAGE_PRJ_H
+#define ERRORMESSAGE_PRJ_H
+
+/*
+ * This file is part of the libopeninv-arduino ISA example.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Error messages are reported as ERR_<name>.
+   Their position in this list is the error number reported via SDO and EMCY,
+   so only ever append new entries.
+ */
+/*                  name           type */
+#define ERROR_MESSAGE_LIST \
+    ERROR_MESSAGE_ENTRY(CANTIMEOUT,    ERROR_DISPLAY) \
+    ERROR_MESSAGE_ENTRY(SHUNTTIMEOUT,  ERROR_DERATE) \
+    ERROR_MESSAGE_ENTRY(NODELOST,      ERROR_DISPLAY)
+
+#endif // ERRORMESSAGE_PRJ_H
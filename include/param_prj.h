@@ -41,6 +41,8 @@
     VALUE_ENTRY(isaAh,       "Ah",                 1105) \
     VALUE_ENTRY(isaKW,       "kW",                 1106) \
     VALUE_ENTRY(isaKWh,      "kWh",                1107) \
+    VALUE_ENTRY(isaAhInt,    "Ah",                 1108) \
+    VALUE_ENTRY(isaKWhInt,   "kWh",                1109) \
     VALUE_ENTRY(BMS_Vmin,    "V",                  2084) \
     VALUE_ENTRY(BMS_Vmax,    "V",                  2085) \
     VALUE_ENTRY(BMS_Tmin,    "C",                  2086) \
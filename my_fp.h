@@ -35,6 +35,99 @@
 #define UTOA_FRACDEC 100
 #define FP_DECIMALS 2
 
+typedef uint32_t u32fp;
+typedef int32_t s32fp;
+typedef int16_t s16fp;
+typedef uint16_t u16fp;
+
+#ifdef __cplusplus
+
+template <bool isSigned> struct FixedWide { typedef int64_t Type; };
+template <> struct FixedWide<false> { typedef uint64_t Type; };
+
+/* Fixed point number with FracBits fractional bits stored in an integer of up to 32 bits.
+   All arithmetic goes through a 64-bit intermediate and saturates at the limits of Storage
+   instead of wrapping. Everything is constexpr, so constants like Fixed<5>::FromFloat(0.1f)
+   are converted by the compiler.
+ */
+template <int FracBits, typename Storage = int32_t>
+class Fixed
+{
+   static_assert(sizeof(Storage) <= 4, "Storage must not exceed 32 bits");
+   static_assert(FracBits >= 0 && FracBits < (int)sizeof(Storage) * 8, "Too many fractional bits");
+
+public:
+   typedef Storage StorageType;
+   typedef typename FixedWide<(Storage(-1) < Storage(0))>::Type WideType;
+
+   constexpr Fixed() : raw(0) {}
+
+   static constexpr Fixed FromRaw(Storage r) { return Fixed(r, true); }
+   static constexpr Fixed FromInt(int32_t i) { return FromRaw(Saturate((WideType)i * One())); }
+   static constexpr Fixed FromFloat(float f)
+   {
+      return FromRaw(f >= MaxRaw() ? MaxRaw() : f <= MinRaw() ? MinRaw() : (Storage)(f * One()));
+   }
+
+   /** \brief Convert from another format, truncating extra fractional bits */
+   template <int OtherBits, typename OtherStorage>
+   static constexpr Fixed From(Fixed<OtherBits, OtherStorage> other)
+   {
+      return FromRaw(Saturate(Shift(other.Raw(), FracBits - OtherBits)));
+   }
+
+   constexpr Storage Raw() const { return raw; }
+   constexpr int32_t ToInt() const { return raw >> FracBits; }
+   constexpr float ToFloat() const { return (float)raw / One(); }
+
+   constexpr Fixed operator+(Fixed b) const { return FromRaw(Saturate((WideType)raw + b.raw)); }
+   constexpr Fixed operator-(Fixed b) const
+   {
+      return FromRaw(!IsSigned() && raw < b.raw ? 0 : Saturate((WideType)raw - b.raw));
+   }
+   constexpr Fixed operator-() const { return Fixed() - *this; }
+   constexpr Fixed operator*(Fixed b) const { return FromRaw(Saturate(((WideType)raw * b.raw) >> FracBits)); }
+   constexpr Fixed operator/(Fixed b) const { return FromRaw(Saturate((WideType)raw * One() / b.raw)); }
+
+   Fixed& operator+=(Fixed b) { return *this = *this + b; }
+   Fixed& operator-=(Fixed b) { return *this = *this - b; }
+   Fixed& operator*=(Fixed b) { return *this = *this * b; }
+   Fixed& operator/=(Fixed b) { return *this = *this / b; }
+
+   constexpr bool operator==(Fixed b) const { return raw == b.raw; }
+   constexpr bool operator!=(Fixed b) const { return raw != b.raw; }
+   constexpr bool operator<(Fixed b) const { return raw < b.raw; }
+   constexpr bool operator>(Fixed b) const { return raw > b.raw; }
+   constexpr bool operator<=(Fixed b) const { return raw <= b.raw; }
+   constexpr bool operator>=(Fixed b) const { return raw >= b.raw; }
+
+   static constexpr bool IsSigned() { return Storage(-1) < Storage(0); }
+   static constexpr WideType One() { return (WideType)1 << FracBits; }
+   static constexpr WideType MaxRaw() { return ((WideType)1 << (sizeof(Storage) * 8 - IsSigned())) - 1; }
+   static constexpr WideType MinRaw() { return IsSigned() ? -MaxRaw() - 1 : 0; }
+
+private:
+   Storage raw;
+
+   constexpr Fixed(Storage r, bool) : raw(r) {}
+
+   static constexpr Storage Saturate(WideType v)
+   {
+      return v > MaxRaw() ? MaxRaw() : v < MinRaw() ? MinRaw() : v;
+   }
+
+   static constexpr WideType Shift(WideType v, int bits)
+   {
+      return bits >= 0 ? v * ((WideType)1 << bits) : v >> -bits;
+   }
+};
+
+//Saturating counterpart of the classic macros below on raw s32fp values
+typedef Fixed<CST_DIGITS> FixedCst;
+
+#endif // __cplusplus
+
+//The classic macros keep their plain integer semantics, they overflow like before
 #define FP_TOFLOAT(a) (((float)a) / FRAC_FAC)
 #define FP_FROMINT(a) ((s32fp)((a) << CST_DIGITS))
 #define FP_TOINT(a)   ((s32fp)((a) >> CST_DIGITS))
@@ -43,9 +136,4 @@
 #define FP_MUL(a, b) (((a) * (b)) >> CST_DIGITS)
 #define FP_DIV(a, b) (((a) << CST_DIGITS) / (b))
 
-typedef uint32_t u32fp;
-typedef int32_t s32fp;
-typedef int16_t s16fp;
-typedef uint16_t u16fp;
-
 #endif
@@ -19,6 +19,70 @@
 #ifndef MY_MATH_H_INCLUDED
 #define MY_MATH_H_INCLUDED
 
+#ifdef __cplusplus
+
+/* Function versions of the classic macros, which stay available under their old names.
+   Arguments are evaluated once and the result has the type the macro expression had.
+   Written as single return statements so they stay constexpr in C++11.
+ */
+namespace Math
+{
+   template <typename T>
+   constexpr decltype(-T()) Abs(T a) { return a < 0 ? -a : a; }
+
+   template <typename T>
+   constexpr int Sign(T a) { return a < 0 ? -1 : 1; }
+
+   template <typename A, typename B>
+   constexpr decltype(A() + B()) Min(A a, B b) { return a < b ? a : b; }
+
+   template <typename A, typename B>
+   constexpr decltype(A() + B()) Max(A a, B b) { return a > b ? a : b; }
+
+   template <typename C, typename T, typename R>
+   constexpr decltype(C() + T() + R()) RampUp(C current, T target, R rate)
+   {
+      return (target < current || (current + rate) > target) ? target : current + rate;
+   }
+
+   template <typename C, typename T, typename R>
+   constexpr decltype(C() + T() + R()) RampDown(C current, T target, R rate)
+   {
+      return (target > current || (current - rate) < target) ? target : current - rate;
+   }
+
+   template <typename L, typename N>
+   constexpr decltype(L() + N()) IirFilter(L last, N next, int c)
+   {
+      return (next + (last << c) - last) >> c;
+   }
+
+   template <typename L, typename N>
+   constexpr decltype(L() + N()) IirFilterF(L last, N next, int c)
+   {
+      return (next + last * ((1 << c) - 1)) / (1 << c);
+   }
+
+   template <typename A, typename B, typename C>
+   constexpr decltype(A() + B() + C()) Median3(A a, B b, C c)
+   {
+      return a > b ? (b > c ? b : (a > c ? c : a))
+                   : (a > c ? a : (b > c ? c : b));
+   }
+}
+
+#define ABS(a)   Math::Abs(a)
+#define SIGN(a)  Math::Sign(a)
+#define MIN(a,b) Math::Min(a, b)
+#define MAX(a,b) Math::Max(a, b)
+#define RAMPUP(current, target, rate) Math::RampUp(current, target, rate)
+#define RAMPDOWN(current, target, rate) Math::RampDown(current, target, rate)
+#define IIRFILTER(l,n,c) Math::IirFilter(l, n, c)
+#define IIRFILTERF(l,n,c) Math::IirFilterF(l, n, c)
+#define MEDIAN3(a,b,c)  Math::Median3(a, b, c)
+
+#else
+
 #define ABS(a)   ((a) < 0?(-(a)) : (a))
 #define SIGN(a)  ((a) < 0? -1 : 1)
 #define MIN(a,b) ((a) < (b)?(a):(b))
@@ -29,6 +93,9 @@
 #define IIRFILTERF(l,n,c) (((n) + (l) * ((1 << (c)) - 1)) / (1 << (c)))
 #define MEDIAN3(a,b,c)  ((a) > (b) ? ((b) > (c) ? (b) : ((a) > (c) ? (c) : (a))) \
                                    : ((a) > (c) ? (a) : ((b) > (c) ? (c) : (b))))
+
+#endif // __cplusplus
+
 #define CHK_BIPOLAR_OFS(ofs) ((ofs < (2048 - 512)) || (ofs > (2048 + 512)))
 
 #endif // MY_MATH_H_INCLUDED
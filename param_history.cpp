@@ -0,0 +1,196 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "param_history.h"
+#include <string.h>
+
+#define SAMPLE_SLOT(pos)   samples[(pos) & (HISTORY_DEPTH - 1)]
+
+static_assert((HISTORY_DEPTH & (HISTORY_DEPTH - 1)) == 0, "HISTORY_DEPTH must be a power of 2");
+
+ParamHistory::ParamHistory()
+ : statsCount(0), writePos(0), readStart(0), readPos(0), readEnd(0), lastSample(0),
+   lastRead(0), currentTime(0), interval(100), numChannels(0), reading(false)
+{
+   ResetStats();
+}
+
+/** \brief Record a parameter in the next free channel
+ *
+ * \param param parameter or spot value to record
+ * \return true: success, false: all HISTORY_CHANNELS in use
+ *
+ */
+bool ParamHistory::AddChannel(Param::PARAM_NUM param)
+{
+   if (numChannels >= HISTORY_CHANNELS || param >= Param::PARAM_LAST) return false;
+
+   channels[numChannels++] = param;
+   writePos = 0; //recorded samples don't match the new channel layout
+   reading = false;
+   ResetStats();
+   return true;
+}
+
+void ParamHistory::ClearChannels()
+{
+   numChannels = 0;
+   writePos = 0;
+   reading = false;
+   ResetStats();
+}
+
+Param::PARAM_NUM ParamHistory::GetChannel(int channel)
+{
+   return channel < numChannels ? channels[channel] : Param::PARAM_INVALID;
+}
+
+/** \brief Take a sample every SetInterval() ms
+ *
+ * \param time current time in ms, e.g. millis()
+ * \return void
+ *
+ */
+void ParamHistory::Task(uint32_t time)
+{
+   currentTime = time;
+
+   if (reading && (time - lastRead) > HISTORY_READ_TIMEOUT)
+      reading = false;
+
+   if ((time - lastSample) >= interval)
+   {
+      lastSample = time;
+      Sample();
+   }
+}
+
+/** \brief Record the current value of all channels, O(1) */
+void ParamHistory::Sample()
+{
+   if (reading || numChannels == 0) return;
+
+   float* slot = SAMPLE_SLOT(writePos);
+
+   for (int i = 0; i < numChannels; i++)
+   {
+      float val = Param::GetFloat(channels[i]);
+
+      slot[i] = val;
+      sum[i] += val;
+      if (val < minValue[i]) minValue[i] = val;
+      if (val > maxValue[i]) maxValue[i] = val;
+   }
+
+   statsCount++;
+   writePos++;
+}
+
+/** \brief Restart min/max/mean calculation, the recorded samples are kept */
+void ParamHistory::ResetStats()
+{
+   for (int i = 0; i < HISTORY_CHANNELS; i++)
+   {
+      minValue[i] = 3.4e38f;
+      maxValue[i] = -3.4e38f;
+      sum[i] = 0;
+   }
+   statsCount = 0;
+}
+
+int ParamHistory::GetNumSamples()
+{
+   return writePos < HISTORY_DEPTH ? writePos : HISTORY_DEPTH;
+}
+
+/** \brief Get a recorded sample
+ *
+ * \param channel channel index in order of AddChannel()
+ * \param age 0 for the most recent sample up to GetNumSamples() - 1
+ * \return recorded value, 0 if not recorded
+ *
+ */
+float ParamHistory::GetSample(int channel, int age)
+{
+   if (channel >= numChannels || age >= GetNumSamples()) return 0;
+
+   return SAMPLE_SLOT(writePos - 1 - age)[channel];
+}
+
+float ParamHistory::GetMin(int channel)
+{
+   return channel < numChannels && statsCount > 0 ? minValue[channel] : 0;
+}
+
+float ParamHistory::GetMax(int channel)
+{
+   return channel < numChannels && statsCount > 0 ? maxValue[channel] : 0;
+}
+
+float ParamHistory::GetMean(int channel)
+{
+   return channel < numChannels && statsCount > 0 ? (float)(sum[channel] / statsCount) : 0;
+}
+
+/** \brief Start reading out all recorded samples and pause sampling until done
+ *
+ * \return number of bytes that Read() will deliver
+ *
+ */
+uint32_t ParamHistory::BeginRead()
+{
+   readStart = writePos - GetNumSamples();
+   readPos = 0;
+   readEnd = GetNumSamples() * numChannels * sizeof(float);
+   lastRead = currentTime;
+   reading = readEnd > 0;
+   return readEnd;
+}
+
+/** \brief Read the next bytes of the readout started with BeginRead()
+ *
+ * \param out destination buffer
+ * \param maxLen size of destination buffer
+ * \return number of bytes copied, less than maxLen at the end of the readout
+ *
+ */
+size_t ParamHistory::Read(uint8_t* out, size_t maxLen)
+{
+   size_t count = 0;
+
+   for (; count < maxLen && readPos < readEnd; count++, readPos++)
+   {
+      uint32_t value = readPos / sizeof(float);
+      float* slot = SAMPLE_SLOT(readStart + value / numChannels);
+      uint8_t bytes[sizeof(float)];
+
+      memcpy(bytes, &slot[value % numChannels], sizeof(float));
+      out[count] = bytes[readPos % sizeof(float)];
+   }
+
+   lastRead = currentTime;
+   if (readPos >= readEnd) reading = false;
+
+   return count;
+}
+
+/** \brief Stream source for segmented SDO upload, history is the ParamHistory* */
+size_t ParamHistory::ReadStream(void* history, uint8_t* out, size_t maxLen)
+{
+   return ((ParamHistory*)history)->Read(out, maxLen);
+}
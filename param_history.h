@@ -0,0 +1,84 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PARAM_HISTORY_H
+#define PARAM_HISTORY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "params.h"
+
+#ifndef HISTORY_CHANNELS
+#define HISTORY_CHANNELS 4
+#endif
+
+//Samples kept per channel, must be a power of 2 for efficient modulo calculation
+#ifndef HISTORY_DEPTH
+#define HISTORY_DEPTH 128
+#endif
+
+//Sampling resumes when a readout was not continued for this long (ms)
+#define HISTORY_READ_TIMEOUT 1000
+
+/* Records selected parameters at a fixed interval into a ring buffer and keeps
+   min/max/mean of every channel since the last ResetStats().
+   Read() streams the buffer oldest sample first, each sample is one little endian
+   float per channel. Sampling is paused while a readout is in progress.
+ */
+class ParamHistory
+{
+   public:
+      ParamHistory();
+      bool AddChannel(Param::PARAM_NUM param);
+      void ClearChannels();
+      int GetNumChannels() { return numChannels; }
+      Param::PARAM_NUM GetChannel(int channel);
+      void SetInterval(uint16_t ms) { interval = ms; }
+      void Task(uint32_t time);
+      void Sample();
+      void ResetStats();
+      int GetNumSamples();
+      float GetSample(int channel, int age);
+      float GetMin(int channel);
+      float GetMax(int channel);
+      float GetMean(int channel);
+      uint32_t GetStatsCount() { return statsCount; }
+      uint32_t BeginRead();
+      size_t Read(uint8_t* out, size_t maxLen);
+      static size_t ReadStream(void* history, uint8_t* out, size_t maxLen);
+
+   private:
+      Param::PARAM_NUM channels[HISTORY_CHANNELS];
+      float samples[HISTORY_DEPTH][HISTORY_CHANNELS];
+      float minValue[HISTORY_CHANNELS];
+      float maxValue[HISTORY_CHANNELS];
+      double sum[HISTORY_CHANNELS];
+      uint32_t statsCount;
+      uint32_t writePos; //non-wrapping, like the ErrorMessage log
+      uint32_t readStart; //first sample of the readout
+      uint32_t readPos; //bytes
+      uint32_t readEnd;
+      uint32_t lastSample;
+      uint32_t lastRead;
+      uint32_t currentTime;
+      uint16_t interval;
+      uint8_t numChannels;
+      bool reading;
+};
+
+#endif // PARAM_HISTORY_H
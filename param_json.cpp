@@ -41,27 +41,24 @@ namespace ParamJson
    {
       DynamicJsonDocument doc(EstimateJsonDocSize());
 
-      for (int i = 0; i < Param::PARAM_LAST; i++)
+      for (Param::PARAM_NUM p: Param::All())
       {
-         const Param::Attributes* attr = Param::GetAttrib((Param::PARAM_NUM)i);
+         const Param::Attributes* attr = Param::GetAttrib(p);
          if (!attr) continue;
 
-         JsonObject param = doc[attr->name].to<JsonObject>();
-         param["unit"] = attr->unit;
-         param["category"] = attr->category;
+         const char* name = Param::GetName(p);
+         JsonObject param = doc[name].to<JsonObject>();
+         param["unit"] = Param::GetUnit(p);
+         param["category"] = Param::GetCategory(p);
          param["minimum"] = attr->min;
          param["maximum"] = attr->max;
          param["default"] = attr->def;
          param["id"] = attr->id;
-         param["isparam"] = (Param::GetType((Param::PARAM_NUM)i) == Param::TYPE_PARAM) ? 1 : 0;
+         param["isparam"] = Param::Params().contains(p) ? 1 : 0;
 
-         if (attr->name != nullptr && strcmp(attr->name, "version") == 0)
+         if (strcmp(name, "version") == 0 || Param::Values().contains(p))
          {
-            param["value"] = Param::GetFloat((Param::PARAM_NUM)i);
-         }
-         else if (Param::GetType((Param::PARAM_NUM)i) == Param::TYPE_SPOTVALUE)
-         {
-            param["value"] = Param::GetFloat((Param::PARAM_NUM)i);
+            param["value"] = Param::GetFloat(p);
          }
       }
 
@@ -2,6 +2,7 @@
 #define PARAM_JSON_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include "params.h"
 
 #ifdef ARDUINO
@@ -8,11 +8,14 @@
 #include "params.h"
 #include "param_save.h"
 #include "my_string.h"
+#include "crc32.h"
+#include <stddef.h>
 
 namespace
 {
-constexpr size_t kParamBlockSize = 2048;
-constexpr int kEepromBase = 0;
+constexpr size_t kParamBlockSize = PARAM_PAGE_SIZE;
+constexpr uint32_t kPageMagic = 0x3250494F; //"OIP2"
+constexpr uint8_t kPageVersion = 1;
 
 typedef struct __attribute__((packed))
 {
@@ -22,69 +25,160 @@ typedef struct __attribute__((packed))
    uint32_t value;
 } PARAM_ENTRY;
 
-constexpr size_t kNumParams = (kParamBlockSize - 8) / sizeof(PARAM_ENTRY);
+/* Page layout version 1. Entries are sorted by parameter id, unused entries
+   at the end have key 0xFFFF. All pages of one save share the generation.
+   The third byte of the magic can never be confused with the dummy byte
+   of the first entry of a legacy page, which is always 0xFF.
+ */
+typedef struct __attribute__((packed))
+{
+   uint32_t magic;
+   uint8_t version;
+   uint8_t page;
+   uint8_t numPages;
+   uint8_t generation;
+} PAGE_HEADER;
+
+constexpr size_t kEntriesPerPage = (kParamBlockSize - sizeof(PAGE_HEADER) - 8) / sizeof(PARAM_ENTRY);
 constexpr size_t kParamWords = kParamBlockSize / 4;
+constexpr size_t kCrcWords = (kParamBlockSize - 8) / 4;
 
 typedef struct __attribute__((packed))
 {
-   PARAM_ENTRY data[kNumParams];
+   PAGE_HEADER header;
+   PARAM_ENTRY data[kEntriesPerPage];
    uint32_t crc;
    uint32_t padding;
 } PARAM_PAGE;
+
+//Legacy layout: one slot per enum index, no header
+constexpr size_t kLegacyNumParams = (kParamBlockSize - 8) / sizeof(PARAM_ENTRY);
+
+typedef struct __attribute__((packed))
+{
+   PARAM_ENTRY data[kLegacyNumParams];
+   uint32_t crc;
+   uint32_t padding;
+} LEGACY_PAGE;
+
+static_assert(sizeof(PARAM_PAGE) == kParamBlockSize, "Parameter page must fill the block");
+static_assert(sizeof(LEGACY_PAGE) == kParamBlockSize, "Legacy page must fill the block");
+
+constexpr size_t kNumSaveable = Param::NUM_PARAMS;
+
+constexpr int kNumPages = kNumSaveable > kEntriesPerPage ? (kNumSaveable + kEntriesPerPage - 1) / kEntriesPerPage : 1;
+
+static_assert(kNumPages <= PARAM_MAX_PAGES, "Too many parameters, increase PARAM_MAX_PAGES");
+
+int PageAddress(int page)
+{
+   return PARAM_EEPROM_BASE + page * kParamBlockSize;
 }
 
-// Simple CRC32 calculation
-static uint32_t calculate_crc32(uint32_t *data, uint32_t length)
+bool IsPageValid(PARAM_PAGE& page, int pageIdx, const PAGE_HEADER& first)
 {
-   uint32_t crc = 0xFFFFFFFF;
+   return page.header.magic == kPageMagic &&
+          page.header.version == kPageVersion &&
+          page.header.page == pageIdx &&
+          page.header.numPages == first.numPages &&
+          page.header.generation == first.generation &&
+          page.crc == crc32_block((uint32_t*)&page, kCrcWords);
+}
 
-   for (uint32_t i = 0; i < length; i++)
+//Merge join of the sorted page entries with the parameters sorted by id
+void MergePage(PARAM_PAGE& page, int& rank)
+{
+   for (unsigned int i = 0; i < kEntriesPerPage && page.data[i].key != 0xFFFF; i++)
    {
-      crc ^= data[i];
-      for (int j = 0; j < 32; j++)
+      const PARAM_ENTRY& entry = page.data[i];
+      Param::PARAM_NUM idx = Param::NumFromIdRank(rank);
+
+      while (idx != Param::PARAM_INVALID && Param::GetAttrib(idx)->id < entry.key)
+         idx = Param::NumFromIdRank(++rank);
+
+      if (idx == Param::PARAM_INVALID) break;
+
+      if (Param::GetAttrib(idx)->id == entry.key && Param::Params().contains(idx))
       {
-         if (crc & 1)
-            crc = (crc >> 1) ^ 0xEDB88320;
-         else
-            crc = crc >> 1;
+         Param::SetFixed(idx, entry.value);
+         Param::SetFlagsRaw(idx, entry.flags);
       }
    }
+}
+
+int LoadLegacy(LEGACY_PAGE& parmPage)
+{
+   uint32_t crc = crc32_block((uint32_t*)&parmPage, 2 * kLegacyNumParams);
+
+   if (crc != parmPage.crc)
+      return -1;
 
-   return ~crc;
+   for (unsigned int idxPage = 0; idxPage < kLegacyNumParams; idxPage++)
+   {
+      if (parmPage.data[idxPage].key == 0xFFFF) continue; //unused slot
+
+      //The legacy format stores each parameter in the slot of its enum index,
+      //so only fall back to searching the id when the list has changed
+      Param::PARAM_NUM idx = (Param::PARAM_NUM)idxPage;
+      if (idxPage >= Param::PARAM_LAST || Param::GetAttrib(idx)->id != parmPage.data[idxPage].key)
+         idx = Param::NumFromId(parmPage.data[idxPage].key);
+      if (Param::Params().contains(idx))
+      {
+         Param::SetFixed(idx, parmPage.data[idxPage].value);
+         Param::SetFlagsRaw(idx, parmPage.data[idxPage].flags);
+      }
+   }
+   return 0;
+}
 }
 
 /**
 * Save parameters to flash
 *
-* @return CRC of parameter flash page
+* @return CRC of first parameter flash page
 */
 uint32_t parm_save()
 {
    PARAM_PAGE parmPage;
-   uint32_t idx;
-
-   memset32((int*)&parmPage, 0xFFFFFFFF, kParamWords);
+   uint32_t firstCrc = 0;
+   int rank = 0;
+   uint8_t generation = EEPROM.read(PageAddress(0) + offsetof(PAGE_HEADER, generation)) + 1;
 
-   // Copy parameter values and keys to block structure
-   for (idx = 0; idx < kNumParams && idx < Param::PARAM_LAST; idx++)
+   for (int page = 0; page < kNumPages; page++)
    {
-      if (Param::GetType((Param::PARAM_NUM)idx) == Param::TYPE_PARAM)
+      memset32((int*)&parmPage, 0xFFFFFFFF, kParamWords);
+      parmPage.header.magic = kPageMagic;
+      parmPage.header.version = kPageVersion;
+      parmPage.header.page = page;
+      parmPage.header.numPages = kNumPages;
+      parmPage.header.generation = generation;
+
+      // Copy parameter values and keys to block structure in order of their id
+      for (unsigned int i = 0; i < kEntriesPerPage && rank < Param::PARAM_LAST; rank++)
       {
-         const Param::Attributes *pAtr = Param::GetAttrib((Param::PARAM_NUM)idx);
-         parmPage.data[idx].flags = (uint8_t)Param::GetFlag((Param::PARAM_NUM)idx);
-         parmPage.data[idx].key = pAtr->id;
-         parmPage.data[idx].value = Param::Get((Param::PARAM_NUM)idx);
+         Param::PARAM_NUM idx = Param::NumFromIdRank(rank);
+
+         if (Param::Params().contains(idx))
+         {
+            parmPage.data[i].flags = (uint8_t)Param::GetFlag(idx) & ~Param::FLAG_RAW;
+            parmPage.data[i].key = Param::GetAttrib(idx)->id;
+            parmPage.data[i].value = Param::Get(idx);
+            i++;
+         }
       }
-   }
 
-   parmPage.crc = calculate_crc32((uint32_t*)&parmPage, 2 * kNumParams);
-   EEPROM.put(kEepromBase, parmPage);
+      parmPage.crc = crc32_block((uint32_t*)&parmPage, kCrcWords);
+      EEPROM.put(PageAddress(page), parmPage);
+
+      if (page == 0) firstCrc = parmPage.crc;
+   }
 
-   return parmPage.crc;
+   return firstCrc;
 }
 
 /**
 * Load parameters from flash
+* Pages in the legacy layout are loaded as well, the next parm_save() converts them
 *
 * @retval 0 Parameters loaded successfully
 * @retval -1 CRC error, parameters not loaded
@@ -92,29 +186,35 @@ uint32_t parm_save()
 int parm_load()
 {
    PARAM_PAGE parmPage;
-   EEPROM.get(kEepromBase, parmPage);
+   EEPROM.get(PageAddress(0), parmPage);
 
-   uint32_t crc = calculate_crc32((uint32_t*)&parmPage, 2 * kNumParams);
+   if (parmPage.header.magic != kPageMagic)
+      return LoadLegacy((LEGACY_PAGE&)parmPage);
 
-   if (crc == parmPage.crc)
+   PAGE_HEADER first = parmPage.header;
+
+   if (!IsPageValid(parmPage, 0, first) || first.numPages > PARAM_MAX_PAGES)
+      return -1;
+
+   //Verify all pages before applying any value, so a save that was
+   //interrupted half way does not leave us with a mix of two saves
+   for (int page = 1; page < first.numPages; page++)
    {
-      int loaded = 0;
-      for (unsigned int idxPage = 0; idxPage < kNumParams; idxPage++)
-      {
-         Param::PARAM_NUM idx = Param::NumFromId(parmPage.data[idxPage].key);
-         if (idx != Param::PARAM_INVALID && Param::GetType((Param::PARAM_NUM)idx) == Param::TYPE_PARAM)
-         {
-            Param::SetFixed(idx, parmPage.data[idxPage].value);
-            Param::SetFlagsRaw(idx, parmPage.data[idxPage].flags);
-            loaded++;
-         }
-      }
-      return 0;
+      PARAM_PAGE other;
+      EEPROM.get(PageAddress(page), other);
+
+      if (!IsPageValid(other, page, first))
+         return -1;
    }
 
-   // Check if EEPROM is erased (all 0xFF)
-   if (parmPage.crc == 0xFFFFFFFF)
-      return -1;
+   int rank = 0;
+   MergePage(parmPage, rank);
+
+   for (int page = 1; page < first.numPages; page++)
+   {
+      EEPROM.get(PageAddress(page), parmPage);
+      MergePage(parmPage, rank);
+   }
 
-   return -1;
+   return 0;
 }
@@ -19,6 +19,19 @@
 #ifndef PARAM_SAVE_H_INCLUDED
 #define PARAM_SAVE_H_INCLUDED
 
+#include <stdint.h>
+
+#ifndef PARAM_EEPROM_BASE
+#define PARAM_EEPROM_BASE 0
+#endif
+
+//Each page holds 254 parameters. Pages are stored back to back from PARAM_EEPROM_BASE
+#ifndef PARAM_MAX_PAGES
+#define PARAM_MAX_PAGES 1
+#endif
+
+#define PARAM_PAGE_SIZE 2048
+
 #ifdef __cplusplus
 extern "C"
 {
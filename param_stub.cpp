@@ -11,3 +11,16 @@ __attribute__((weak)) void Param::Change(Param::PARAM_NUM ParamNum)
     // Override this in your application to respond to parameter changes
     (void)ParamNum;
 }
+
+// Accept all committed transactions by default
+__attribute__((weak)) bool Param::Validate()
+{
+    return true;
+}
+
+// Notify each parameter of a committed transaction separately by default
+__attribute__((weak)) void Param::ChangeBatch(const Param::PARAM_NUM* params, int count)
+{
+    for (int i = 0; i < count; i++)
+        Param::Change(params[i]);
+}
@@ -19,14 +19,152 @@
 
 #include "params.h"
 #include "my_string.h"
+#include <string.h>
+
+/* With PARAM_DEFAULTS_IN_FLASH the attribute table stays in flash instead of being
+   copied to RAM at startup. On Teensy 4.x values and flags move to DMAMEM, which is
+   not initialized at startup, so LoadDefaults() must be called before any access.
+ */
+#if defined(PARAM_DEFAULTS_IN_FLASH) && defined(ARDUINO)
+#include <Arduino.h>
+#ifdef __AVR__
+#error "PARAM_DEFAULTS_IN_FLASH needs memory mapped flash"
+#endif
+#define PARAM_ROM PROGMEM
+#ifdef DMAMEM
+#define PARAM_RAM DMAMEM
+#endif
+#endif
+
+#ifndef PARAM_ROM
+#define PARAM_ROM
+#endif
+#ifndef PARAM_RAM
+#define PARAM_RAM
+#endif
 
 namespace Param
 {
 
-#define PARAM_ENTRY(category, name, unit, min, max, def, id) { category, #name, unit, min, max, def, id, TYPE_PARAM },
-#define TESTP_ENTRY(category, name, unit, min, max, def, id) { category, #name, unit, min, max, def, id, TYPE_TESTPARAM },
-#define VALUE_ENTRY(name, unit, id) { 0, #name, unit, 0, 0, 0, id, TYPE_SPOTVALUE },
-static const Attributes attribs[] =
+//String pool: all names, followed by each distinct category and unit string once
+#define PARAM_ENTRY(category, name, unit, min, max, def, id) #name,
+#define TESTP_ENTRY(category, name, unit, min, max, def, id) #name,
+#define VALUE_ENTRY(name, unit, id) #name,
+static constexpr const char* poolNames[] =
+{
+    PARAM_LIST
+};
+#undef PARAM_ENTRY
+#undef TESTP_ENTRY
+#undef VALUE_ENTRY
+
+#define PARAM_ENTRY(category, name, unit, min, max, def, id) category, unit,
+#define TESTP_ENTRY(category, name, unit, min, max, def, id) category, unit,
+#define VALUE_ENTRY(name, unit, id) nullptr, unit,
+static constexpr const char* poolShared[] =
+{
+    PARAM_LIST
+};
+#undef PARAM_ENTRY
+#undef TESTP_ENTRY
+#undef VALUE_ENTRY
+
+static constexpr int kNumShared = 2 * PARAM_LAST;
+
+static constexpr bool StrEqual(const char* a, const char* b)
+{
+   while (*a != 0 && *a == *b) { a++; b++; }
+   return *a == *b;
+}
+
+static constexpr unsigned StrSize(const char* s)
+{
+   unsigned size = 1;
+   while (*s++ != 0) size++;
+   return size;
+}
+
+struct StringPoolLayout
+{
+   unsigned size;
+   uint16_t nameOfs[PARAM_LAST];
+   uint16_t sharedOfs[kNumShared];
+
+   //Only compare against strings seen before, there are few distinct categories and units
+   constexpr StringPoolLayout() : size(0), nameOfs(), sharedOfs()
+   {
+      int distinct[kNumShared] = {};
+      int numDistinct = 0;
+
+      for (int i = 0; i < PARAM_LAST; i++)
+      {
+         nameOfs[i] = size;
+         size += StrSize(poolNames[i]);
+      }
+
+      for (int i = 0; i < kNumShared; i++)
+      {
+         int j = 0;
+
+         if (poolShared[i] == nullptr)
+         {
+            sharedOfs[i] = PARAM_STRING_NONE;
+            continue;
+         }
+
+         while (j < numDistinct && !StrEqual(poolShared[distinct[j]], poolShared[i]))
+            j++;
+
+         if (j < numDistinct)
+         {
+            sharedOfs[i] = sharedOfs[distinct[j]];
+         }
+         else
+         {
+            sharedOfs[i] = size;
+            size += StrSize(poolShared[i]);
+            distinct[numDistinct++] = i;
+         }
+      }
+   }
+};
+
+static constexpr StringPoolLayout poolLayout;
+
+static_assert(poolLayout.size < PARAM_STRING_NONE, "String pool exceeds 16 bit offsets");
+
+struct StringPool
+{
+   char data[poolLayout.size];
+
+   constexpr StringPool() : data()
+   {
+      for (int i = 0; i < PARAM_LAST; i++)
+         Copy(poolLayout.nameOfs[i], poolNames[i]);
+
+      for (int i = 0; i < kNumShared; i++)
+      {
+         if (poolShared[i] != nullptr)
+            Copy(poolLayout.sharedOfs[i], poolShared[i]);
+      }
+   }
+
+   constexpr void Copy(unsigned ofs, const char* s)
+   {
+      while (*s != 0) data[ofs++] = *s++;
+      data[ofs] = 0;
+   }
+};
+
+static constexpr StringPool stringPool PARAM_ROM;
+
+#define PARAM_ENTRY(category, name, unit, min, max, def, id) \
+   { min, max, def, poolLayout.sharedOfs[2 * name], poolLayout.nameOfs[name], poolLayout.sharedOfs[2 * name + 1], id, TYPE_PARAM },
+#define TESTP_ENTRY(category, name, unit, min, max, def, id) \
+   { min, max, def, poolLayout.sharedOfs[2 * name], poolLayout.nameOfs[name], poolLayout.sharedOfs[2 * name + 1], id, TYPE_TESTPARAM },
+#define VALUE_ENTRY(name, unit, id) \
+   { 0, 0, 0, PARAM_STRING_NONE, poolLayout.nameOfs[name], poolLayout.sharedOfs[2 * name + 1], id, TYPE_SPOTVALUE },
+static const Attributes attribs[] PARAM_ROM =
 {
     PARAM_LIST
 };
@@ -34,6 +172,10 @@ static const Attributes attribs[] =
 #undef TESTP_ENTRY
 #undef VALUE_ENTRY
 
+#ifdef PARAM_DEFAULTS_IN_FLASH
+static float values[PARAM_LAST] PARAM_RAM;
+static uint8_t flags[PARAM_LAST] PARAM_RAM;
+#else
 #define PARAM_ENTRY(category, name, unit, min, max, def, id) def,
 #define TESTP_ENTRY(category, name, unit, min, max, def, id) def,
 #define VALUE_ENTRY(name, unit, id) 0.0f,
@@ -55,6 +197,19 @@ static uint8_t flags[] =
 #undef PARAM_ENTRY
 #undef TESTP_ENTRY
 #undef VALUE_ENTRY
+#endif
+
+//Values set with SetRaw() keep the integer bits in the float slot, so counters stay exact
+static float ValueOf(PARAM_NUM ParamNum)
+{
+   if (flags[ParamNum] & FLAG_RAW)
+   {
+      uint32_t raw;
+      memcpy(&raw, &values[ParamNum], sizeof(raw));
+      return (float)raw;
+   }
+   return values[ParamNum];
+}
 
 //Duplicate ID check
 #define PARAM_ENTRY(category, name, unit, min, max, def, id) ITEM_##id,
@@ -69,6 +224,69 @@ enum _dupes
 #undef VALUE_ENTRY
 
 
+//Check the ordering required by the type ranges in params.h
+#define PARAM_ENTRY(category, name, unit, min, max, def, id) TYPE_PARAM,
+#define TESTP_ENTRY(category, name, unit, min, max, def, id) TYPE_TESTPARAM,
+#define VALUE_ENTRY(name, unit, id) TYPE_SPOTVALUE,
+static constexpr PARAM_TYPE types[] =
+{
+    PARAM_LIST
+};
+#undef PARAM_ENTRY
+#undef TESTP_ENTRY
+#undef VALUE_ENTRY
+
+static constexpr bool IsOrderedByType()
+{
+   for (int i = 1; i < PARAM_LAST; i++)
+   {
+      if (types[i] < types[i - 1]) return false;
+   }
+   return true;
+}
+
+static_assert(IsOrderedByType(), "PARAM_LIST must list parameters first, then test parameters, then values");
+
+//Parameter enum sorted by unique id, for binary search and merge joins with saved parameters
+#define PARAM_ENTRY(category, name, unit, min, max, def, id) id,
+#define TESTP_ENTRY(category, name, unit, min, max, def, id) id,
+#define VALUE_ENTRY(name, unit, id) id,
+static constexpr uint16_t ids[] PARAM_ROM =
+{
+    PARAM_LIST
+};
+#undef PARAM_ENTRY
+#undef TESTP_ENTRY
+#undef VALUE_ENTRY
+
+struct IdOrder
+{
+   uint16_t num[PARAM_LAST];
+
+   //Insertion sort, linear when the list is already roughly ordered by id
+   constexpr IdOrder() : num()
+   {
+      for (int i = 0; i < PARAM_LAST; i++)
+      {
+         uint16_t cur = i;
+         int j = i - 1;
+
+         for (; j >= 0 && ids[num[j]] > ids[cur]; j--)
+            num[j + 1] = num[j];
+
+         num[j + 1] = cur;
+      }
+   }
+};
+
+static constexpr IdOrder idOrder PARAM_ROM;
+
+//Writes staged between Begin() and Commit()
+static bool transactionOpen = false;
+static int numStaged = 0;
+static PARAM_NUM stagedParams[PARAM_MAX_STAGED];
+static float stagedValues[PARAM_MAX_STAGED];
+
 /**
 * Set a parameter (accepts 5-bit fixed-point for CAN SDO compatibility)
 *
@@ -86,12 +304,58 @@ int Set(PARAM_NUM ParamNum, s32fp ParamVal)
     if (floatVal >= attribs[ParamNum].min && floatVal <= attribs[ParamNum].max)
     {
         values[ParamNum] = floatVal;
+        flags[ParamNum] &= ~FLAG_RAW;
         Change(ParamNum);
         res = 0;
     }
     return res;
 }
 
+/**
+* Set a parameter as part of the open transaction, used by the SDO server
+* Between Begin() and Commit() the value is only staged, Get() still returns the old value.
+* Without a transaction this is the same as Set(). Set() itself is never staged, so
+* received CAN values and the application keep writing directly.
+*
+* @param[in] ParamNum Parameter index
+* @param[in] ParamVal New value of parameter (5-bit fixed-point format)
+* @return 0 if set ok, -1 if ParamVal outside of allowed range, -2 if too many parameters are staged
+*/
+int Stage(PARAM_NUM ParamNum, s32fp ParamVal)
+{
+   if (!transactionOpen) return Set(ParamNum, ParamVal);
+
+   float floatVal = FP_TOFLOAT(ParamVal);
+
+   if (floatVal < attribs[ParamNum].min || floatVal > attribs[ParamNum].max) return -1;
+
+   int i = 0;
+
+   while (i < numStaged && stagedParams[i] != ParamNum) i++;
+
+   if (i == PARAM_MAX_STAGED) return -2;
+
+   stagedParams[i] = ParamNum;
+   stagedValues[i] = floatVal;
+   if (i == numStaged) numStaged++;
+   return 0;
+}
+
+/**
+* Get the value a parameter will have after Commit(), for use in Validate()
+*
+* @param[in] ParamNum Parameter index
+* @return staged value or the current value if the parameter is not staged
+*/
+float GetStagedFloat(PARAM_NUM ParamNum)
+{
+   for (int i = 0; i < numStaged; i++)
+   {
+      if (stagedParams[i] == ParamNum) return stagedValues[i];
+   }
+   return ValueOf(ParamNum);
+}
+
 /**
 * Get a parameters fixed point value (returns 5-bit fixed-point for CAN SDO)
 *
@@ -101,7 +365,12 @@ int Set(PARAM_NUM ParamNum, s32fp ParamVal)
 s32fp Get(PARAM_NUM ParamNum)
 {
     // Convert from float to 5-bit fixed-point for SDO protocol
-    return FP_FROMFLT(values[ParamNum]);
+    float value = ValueOf(ParamNum);
+
+    // Raw counters exceed the fixed-point range from 2^26 on, saturate instead of overflowing
+    if (value >= 2147483648.0f / FRAC_FAC) return INT32_MAX;
+    if (value < -2147483648.0f / FRAC_FAC) return INT32_MIN;
+    return FP_FROMFLT(value);
 }
 
 /**
@@ -112,6 +381,7 @@ s32fp Get(PARAM_NUM ParamNum)
 */
 int GetInt(PARAM_NUM ParamNum)
 {
+    if (flags[ParamNum] & FLAG_RAW) return (int)GetRaw(ParamNum);
     return (int)values[ParamNum];
 }
 
@@ -123,7 +393,7 @@ int GetInt(PARAM_NUM ParamNum)
 */
 float GetFloat(PARAM_NUM ParamNum)
 {
-    return values[ParamNum];
+    return ValueOf(ParamNum);
 }
 
 /**
@@ -134,7 +404,7 @@ float GetFloat(PARAM_NUM ParamNum)
 */
 bool GetBool(PARAM_NUM ParamNum)
 {
-    return (int)values[ParamNum] == 1;
+    return GetInt(ParamNum) == 1;
 }
 
 /**
@@ -146,6 +416,7 @@ bool GetBool(PARAM_NUM ParamNum)
 void SetInt(PARAM_NUM ParamNum, int ParamVal)
 {
    values[ParamNum] = (float)ParamVal;
+   flags[ParamNum] &= ~FLAG_RAW;
 }
 
 /**
@@ -157,6 +428,7 @@ void SetInt(PARAM_NUM ParamNum, int ParamVal)
 void SetFixed(PARAM_NUM ParamNum, s32fp ParamVal)
 {
    values[ParamNum] = FP_TOFLOAT(ParamVal);
+   flags[ParamNum] &= ~FLAG_RAW;
 }
 
 /**
@@ -168,6 +440,38 @@ void SetFixed(PARAM_NUM ParamNum, s32fp ParamVal)
 void SetFloat(PARAM_NUM ParamNum, float ParamVal)
 {
    values[ParamNum] = ParamVal;
+   flags[ParamNum] &= ~FLAG_RAW;
+}
+
+/**
+* Set an unsigned integer value without range check and callback.
+* Unlike SetFloat() all 32 bits are kept, e.g. for counters received via CAN
+*
+* @param[in] ParamNum Parameter index
+* @param[in] ParamVal New value of parameter
+*/
+void SetRaw(PARAM_NUM ParamNum, uint32_t ParamVal)
+{
+   memcpy(&values[ParamNum], &ParamVal, sizeof(ParamVal));
+   flags[ParamNum] |= FLAG_RAW;
+}
+
+/**
+* Get a parameters value as unsigned integer, exact for values set with SetRaw()
+*
+* @param[in] ParamNum Parameter index
+* @return Parameters value
+*/
+uint32_t GetRaw(PARAM_NUM ParamNum)
+{
+   uint32_t raw;
+
+   if (flags[ParamNum] & FLAG_RAW)
+      memcpy(&raw, &values[ParamNum], sizeof(raw));
+   else
+      raw = (uint32_t)(int32_t)values[ParamNum];
+
+   return raw;
 }
 
 /**
@@ -183,7 +487,7 @@ PARAM_NUM NumFromString(const char *name)
 
     for (int i = 0; i < PARAM_LAST; i++, pCurAtr++)
     {
-         if (0 == my_strcmp(pCurAtr->name, name))
+         if (0 == my_strcmp(GetString(pCurAtr->name), name))
          {
              paramNum = (PARAM_NUM)i;
              break;
@@ -200,18 +504,33 @@ PARAM_NUM NumFromString(const char *name)
 */
 PARAM_NUM NumFromId(uint32_t id)
 {
-    PARAM_NUM paramNum = PARAM_INVALID;
-    const Attributes *pCurAtr = attribs;
+    int first = 0, last = PARAM_LAST - 1;
 
-    for (int i = 0; i < PARAM_LAST; i++, pCurAtr++)
+    while (first <= last)
     {
-         if (pCurAtr->id == id)
-         {
-             paramNum = (PARAM_NUM)i;
-             break;
-         }
+        int mid = (first + last) / 2;
+        uint16_t midId = ids[idOrder.num[mid]];
+
+        if (midId == id)
+            return (PARAM_NUM)idOrder.num[mid];
+        else if (midId < id)
+            first = mid + 1;
+        else
+            last = mid - 1;
     }
-    return paramNum;
+    return PARAM_INVALID;
+}
+
+/**
+* Get the parameter with the n-th lowest unique id
+*
+* @param[in] rank 0 for the lowest id up to PARAM_LAST - 1 for the highest
+* @return Parameter index, PARAM_INVALID if rank is out of range
+*/
+PARAM_NUM NumFromIdRank(int rank)
+{
+    if (rank < 0 || rank >= PARAM_LAST) return PARAM_INVALID;
+    return (PARAM_NUM)idOrder.num[rank];
 }
 
 /**
@@ -225,6 +544,95 @@ const Attributes *GetAttrib(PARAM_NUM ParamNum)
     return &attribs[ParamNum];
 }
 
+/**
+* Get a string from the parameter string pool
+*
+* @param[in] offset Offset as stored in the parameter attributes
+* @return Zero terminated string, nullptr for PARAM_STRING_NONE
+*/
+const char* GetString(uint16_t offset)
+{
+   return offset < sizeof(stringPool.data) ? &stringPool.data[offset] : nullptr;
+}
+
+/**
+* Get the whole string pool, e.g. for sending a parameter catalogue
+*
+* @param[out] size Size of the pool in bytes
+* @return Start of the pool
+*/
+const char* GetStringPool(uint16_t& size)
+{
+   size = sizeof(stringPool.data);
+   return stringPool.data;
+}
+
+const char* GetName(PARAM_NUM ParamNum)
+{
+   return GetString(attribs[ParamNum].name);
+}
+
+const char* GetUnit(PARAM_NUM ParamNum)
+{
+   return GetString(attribs[ParamNum].unit);
+}
+
+const char* GetCategory(PARAM_NUM ParamNum)
+{
+   return GetString(attribs[ParamNum].category);
+}
+
+/**
+* Start a transaction. Following calls to Stage(), e.g. from SDO writes, are staged until Commit()
+* Staged writes of a previous transaction that was not committed are discarded
+*/
+void Begin()
+{
+   numStaged = 0;
+   transactionOpen = true;
+}
+
+/**
+* Check the staged writes with Validate(), then apply them at once
+* If Validate() rejects the new values nothing is changed
+*
+* @return 0 if committed, -1 if rejected by Validate() or no transaction open
+*/
+int Commit()
+{
+   if (!transactionOpen) return -1;
+
+   transactionOpen = false;
+
+   if (!Validate())
+   {
+      numStaged = 0;
+      return -1;
+   }
+
+   for (int i = 0; i < numStaged; i++)
+   {
+      values[stagedParams[i]] = stagedValues[i];
+      flags[stagedParams[i]] &= ~FLAG_RAW;
+   }
+
+   ChangeBatch(stagedParams, numStaged);
+   numStaged = 0;
+   return 0;
+}
+
+/** Discard all staged writes */
+void Abort()
+{
+   numStaged = 0;
+   transactionOpen = false;
+}
+
+bool InTransaction()
+{
+   return transactionOpen;
+}
+
 /** Load default values for all parameters */
 void LoadDefaults()
 {
@@ -234,6 +642,13 @@ void LoadDefaults()
    {
       if (curAtr->id > 0)
          values[idx] = curAtr->def;
+#ifdef PARAM_DEFAULTS_IN_FLASH
+      else
+         values[idx] = 0;
+      flags[idx] = FLAG_NONE;
+#else
+      flags[idx] &= ~FLAG_RAW;
+#endif
    }
 }
 
@@ -23,6 +23,11 @@
 #include "param_prj.h"
 #include "my_fp.h"
 
+//Maximum number of parameters staged between Begin() and Commit()
+#ifndef PARAM_MAX_STAGED
+#define PARAM_MAX_STAGED 16
+#endif
+
 namespace Param
 {
    #define PARAM_ENTRY(category, name, unit, min, max, def, id) name,
@@ -38,10 +43,64 @@ namespace Param
    #undef TESTP_ENTRY
    #undef VALUE_ENTRY
 
+   //Entry counts per type. PARAM_LIST is ordered by type, which params.cpp checks at compile time
+   #define PARAM_ENTRY(category, name, unit, min, max, def, id) 1 +
+   #define TESTP_ENTRY(category, name, unit, min, max, def, id) 0 +
+   #define VALUE_ENTRY(name, unit, id) 0 +
+   static constexpr int NUM_PARAMS = PARAM_LIST 0;
+   #undef PARAM_ENTRY
+   #undef TESTP_ENTRY
+   #undef VALUE_ENTRY
+   #define PARAM_ENTRY(category, name, unit, min, max, def, id) 0 +
+   #define TESTP_ENTRY(category, name, unit, min, max, def, id) 1 +
+   #define VALUE_ENTRY(name, unit, id) 0 +
+   static constexpr int NUM_TESTPARAMS = PARAM_LIST 0;
+   #undef PARAM_ENTRY
+   #undef TESTP_ENTRY
+   #undef VALUE_ENTRY
+
+   static constexpr int FIRST_TESTPARAM = NUM_PARAMS;
+   static constexpr int FIRST_VALUE = NUM_PARAMS + NUM_TESTPARAMS;
+   static constexpr int NUM_VALUES = PARAM_LAST - FIRST_VALUE;
+
+   /** \brief Iterates over a contiguous range of parameter indexes, e.g. for (auto p: Param::Values()) */
+   class Range
+   {
+      public:
+         class Iterator
+         {
+            public:
+               constexpr explicit Iterator(int n) : num(n) {}
+               constexpr PARAM_NUM operator*() const { return (PARAM_NUM)num; }
+               Iterator& operator++() { num++; return *this; }
+               constexpr bool operator!=(const Iterator& other) const { return num != other.num; }
+            private:
+               int num;
+         };
+
+         constexpr Range(int first, int last) : first(first), last(last) {}
+         constexpr Iterator begin() const { return Iterator(first); }
+         constexpr Iterator end() const { return Iterator(last); }
+         constexpr int size() const { return last - first; }
+         constexpr bool contains(int num) const { return num >= first && num < last; }
+
+      private:
+         int first;
+         int last;
+   };
+
+   constexpr Range All() { return Range(0, PARAM_LAST); }
+   constexpr Range Params() { return Range(0, FIRST_TESTPARAM); }
+   constexpr Range TestParams() { return Range(FIRST_TESTPARAM, FIRST_VALUE); }
+   constexpr Range Values() { return Range(FIRST_VALUE, PARAM_LAST); }
+   //Parameters and test parameters, i.e. everything that is range checked on Set()
+   constexpr Range Writable() { return Range(0, FIRST_VALUE); }
+
    typedef enum
    {
       FLAG_NONE = 0,
-      FLAG_HIDDEN = 1
+      FLAG_HIDDEN = 1,
+      FLAG_RAW = 2 //Value holds an unsigned integer set with SetRaw()
    } PARAM_FLAG;
 
    typedef enum
@@ -51,14 +110,17 @@ namespace Param
       TYPE_SPOTVALUE,
    } PARAM_TYPE;
 
+   //Strings are stored as offsets into a deduplicated string pool, see GetString()
+   #define PARAM_STRING_NONE 0xFFFF
+
    typedef struct
    {
-      char const *category;
-      char const *name;
-      char const *unit;
       float min;
       float max;
       float def;
+      uint16_t category;
+      uint16_t name;
+      uint16_t unit;
       uint16_t id;
       uint16_t type;
    } Attributes;
@@ -71,9 +133,17 @@ namespace Param
    void   SetInt(PARAM_NUM ParamNum, int ParamVal);
    void   SetFixed(PARAM_NUM ParamNum, s32fp ParamVal);
    void   SetFloat(PARAM_NUM ParamNum, float ParamVal);
+   void   SetRaw(PARAM_NUM ParamNum, uint32_t ParamVal);
+   uint32_t GetRaw(PARAM_NUM ParamNum);
    PARAM_NUM NumFromString(const char *name);
    PARAM_NUM NumFromId(uint32_t id);
+   PARAM_NUM NumFromIdRank(int rank);
    const Attributes *GetAttrib(PARAM_NUM ParamNum);
+   const char* GetString(uint16_t offset);
+   const char* GetStringPool(uint16_t& size);
+   const char* GetName(PARAM_NUM ParamNum);
+   const char* GetUnit(PARAM_NUM ParamNum);
+   const char* GetCategory(PARAM_NUM ParamNum);
    void LoadDefaults();
    void SetFlagsRaw(PARAM_NUM param, uint8_t rawFlags);
    void SetFlag(PARAM_NUM param, PARAM_FLAG flag);
@@ -81,9 +151,20 @@ namespace Param
    PARAM_FLAG GetFlag(PARAM_NUM param);
    PARAM_TYPE GetType(PARAM_NUM param);
    uint32_t GetIdSum();
+   void   Begin();
+   int    Stage(PARAM_NUM param, s32fp value);
+   float  GetStagedFloat(PARAM_NUM param);
+   int    Commit();
+   void   Abort();
+   bool   InTransaction();
 
    //User defined callback
    void Change(Param::PARAM_NUM ParamNum);
+   //User defined cross-parameter check on commit, return false to reject the transaction.
+   //Use GetStagedFloat() to see the new values, Get() still returns the old ones
+   bool Validate();
+   //User defined callback after commit, defaults to calling Change() for each parameter
+   void ChangeBatch(const Param::PARAM_NUM* params, int count);
 }
 
 #endif //PARAM_H_INCLUDED
@@ -0,0 +1,629 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "provisioner.h"
+
+/* Steps of a target: read the id sum, the skipped parameters and both checksums.
+   Then write the parameters, clear the maps and write the map items (3 steps each),
+   read both checksums again and send the save commands. Steps that are not
+   needed are skipped.
+   Steps of the master: read the id sum and the parameters, then read the maps
+   back message by message in one step that is sent repeatedly. */
+#define MASTER_STEP_MAPS   (image.numParams + 1)
+#define MASTER_STEP_END    (image.numParams + 2)
+
+/** \brief Fleet provisioning client
+ *
+ * \param sdo CanSdo whose client side sends the requests
+ *
+ */
+Provisioner::Provisioner(CanSdo* sdo)
+ : canSdo(sdo), imageValid(false), skip(nullptr), numSkip(0), numLanes(0), state(Idle), window(4),
+   retries(2), timeout(200), clientAdded(false), now(0), paramSum(0), mapSum(0), nodeCallback(nullptr)
+{
+}
+
+/** \brief Take the image from this node
+ *
+ * \param canMap map of this node, may be null
+ * \return false if the map has more than PROVISION_MAX_MAP_ITEMS items
+ *
+ */
+bool Provisioner::LoadLocal(CanMap* canMap)
+{
+   image.idSum = Param::GetIdSum();
+   image.numParams = 0;
+   image.numMaps = 0;
+   imageValid = false;
+
+   for (auto param: Param::Params())
+   {
+      uint16_t id = Param::GetAttrib(param)->id;
+
+      if (IsSkipped(id)) continue;
+
+      image.params[image.numParams].id = id;
+      image.params[image.numParams].value = Param::Get(param);
+      image.numParams++;
+   }
+
+   for (int rx = 0; rx < 2 && canMap != nullptr; rx++)
+   {
+      for (int msg = 0; msg < MAX_MESSAGES; msg++)
+      {
+         uint32_t canId;
+         const CanMap::CANPOS* canPos;
+
+         for (int item = 0; (canPos = canMap->GetMap(rx, msg, item, canId)) != 0; item++)
+         {
+            if (image.numMaps == PROVISION_MAX_MAP_ITEMS) return false;
+
+            MAPITEM& mapItem = image.maps[image.numMaps++];
+            mapItem.rx = rx;
+            mapItem.cobId = canId;
+            mapItem.item = SdoServer::MapItemWord(canPos);
+            mapItem.gain = SdoServer::MapGainWord(canPos);
+         }
+      }
+   }
+
+   imageValid = true;
+   return true;
+}
+
+/** \brief Start provisioning
+ *
+ * \param masterId node to read the image from, 0 to use the loaded image
+ * \param targets node ids to write the image to
+ * \param count number of targets, at most PROVISION_MAX_NODES
+ * \param time current time in ms, e.g. millis()
+ * \return false: already running, too many targets or no image loaded
+ *
+ */
+bool Provisioner::Start(uint8_t masterId, const uint8_t* targets, int count, uint32_t time)
+{
+   if (state == Reading || state == Writing || count > PROVISION_MAX_NODES) return false;
+   if (masterId == 0 && !imageValid) return false;
+
+   if (!clientAdded)
+      clientAdded = canSdo->AddClient(this);
+
+   for (int i = 0; i < count; i++)
+      InitLane(lanes[i], targets[i]);
+
+   numLanes = count;
+   now = time;
+
+   if (masterId != 0)
+   {
+      //The master runs the same firmware, so we know which parameters to read
+      image.numParams = 0;
+      image.numMaps = 0;
+      imageValid = false;
+
+      for (auto param: Param::Params())
+      {
+         uint16_t id = Param::GetAttrib(param)->id;
+
+         if (!IsSkipped(id))
+            image.params[image.numParams++].id = id;
+      }
+
+      InitLane(master, masterId);
+      master.readRx = false;
+      master.readMsg = 0;
+      master.readSub = 0;
+      state = Reading;
+      Pump(master);
+   }
+   else
+   {
+      StartTargets();
+   }
+   return true;
+}
+
+void Provisioner::Abort()
+{
+   if (state == Reading || state == Writing)
+      state = Failed;
+}
+
+/** \brief Handle timeouts and send further requests, call from loop()
+ *
+ * \param time current time in ms, e.g. millis()
+ * \return state after processing
+ *
+ */
+enum Provisioner::states Provisioner::Run(uint32_t time)
+{
+   now = time;
+
+   if (state == Reading)
+   {
+      CheckTimeout(master);
+      Pump(master);
+
+      if (master.result == NodeDone)
+      {
+         imageValid = true;
+         StartTargets();
+      }
+      else if (master.result == NodeFailed)
+      {
+         state = Failed;
+      }
+   }
+
+   if (state == Writing)
+   {
+      bool finished = true;
+      bool failed = false;
+
+      for (int i = 0; i < numLanes; i++)
+      {
+         CheckTimeout(lanes[i]);
+         Pump(lanes[i]);
+         finished &= lanes[i].result != NodeBusy;
+         failed |= lanes[i].result == NodeFailed;
+      }
+
+      if (finished)
+         state = failed ? Failed : Done;
+   }
+   return state;
+}
+
+void Provisioner::HandleSdoReply(uint8_t nodeId, const SdoServer::SdoFrame* reply)
+{
+   LANE* lane = nullptr;
+
+   if (state == Reading && nodeId == master.nodeId)
+   {
+      lane = &master;
+   }
+   else if (state == Writing)
+   {
+      for (int i = 0; i < numLanes; i++)
+      {
+         if (lanes[i].nodeId == nodeId)
+            lane = &lanes[i];
+      }
+   }
+
+   if (lane == nullptr || lane->numInFlight == 0) return;
+
+   REQUEST request = lane->inFlight[lane->head];
+
+   //Stray reply, e.g. to a request that has timed out
+   if (reply->index != request.frame.index || reply->subIndex != request.frame.subIndex) return;
+
+   lane->head = (lane->head + 1) % PROVISION_MAX_WINDOW;
+   lane->numInFlight--;
+   lane->sentTime = now;
+
+   if (lane->draining)
+   {
+      //Requests sent after the aborted one, they are sent again
+      if (lane->numInFlight == 0)
+      {
+         lane->draining = false;
+         lane->step = lane->retryStep;
+      }
+   }
+   else
+   {
+      bool ok = lane == &master ? HandleMasterReply(*lane, request.step, reply) : HandleTargetReply(*lane, request.step, reply);
+
+      if (!ok)
+         Retry(*lane, request.step);
+   }
+
+   Pump(*lane);
+}
+
+/****************** Private methods ********************/
+
+void Provisioner::StartTargets()
+{
+   paramSum = 0;
+   mapSum = 0;
+
+   for (int i = 0; i < image.numParams; i++)
+      paramSum += SdoServer::ParamChecksum(image.params[i].id, image.params[i].value);
+
+   for (int i = 0; i < image.numMaps; i++)
+      mapSum += SdoServer::MapChecksum(image.maps[i].rx, image.maps[i].cobId, image.maps[i].item, image.maps[i].gain);
+
+   state = Writing;
+
+   for (int i = 0; i < numLanes; i++)
+   {
+      lanes[i].paramSum = paramSum;
+      Pump(lanes[i]);
+   }
+}
+
+void Provisioner::InitLane(LANE& lane, uint8_t nodeId)
+{
+   lane.nodeId = nodeId;
+   lane.result = NodeBusy;
+   lane.step = 0;
+   lane.head = 0;
+   lane.numInFlight = 0;
+   lane.attempts = 0;
+   lane.waiting = false;
+   lane.draining = false;
+   lane.paramsOk = false;
+   lane.mapsOk = false;
+}
+
+//Fill the window of the lane
+void Provisioner::Pump(LANE& lane)
+{
+   while (lane.result == NodeBusy && !lane.waiting && !lane.draining && lane.numInFlight < window)
+   {
+      SdoServer::SdoFrame* frame = &lane.inFlight[(lane.head + lane.numInFlight) % PROVISION_MAX_WINDOW].frame;
+      bool barrier = false;
+
+      if (!MakeRequest(lane, *frame, barrier))
+      {
+         if (lane.numInFlight == 0)
+            Finish(lane, NodeDone);
+         return;
+      }
+
+      lane.inFlight[(lane.head + lane.numInFlight) % PROVISION_MAX_WINDOW].step = lane.step;
+
+      if (lane.numInFlight == 0)
+         lane.sentTime = now;
+
+      lane.numInFlight++;
+      canSdo->SDORequest(lane.nodeId, frame);
+
+      //The reply of a barrier step decides the next step
+      if (barrier)
+         lane.waiting = true;
+      else
+         lane.step++;
+   }
+}
+
+void Provisioner::CheckTimeout(LANE& lane)
+{
+   if (lane.result != NodeBusy || lane.numInFlight == 0 || (now - lane.sentTime) <= timeout) return;
+
+   //While draining the step to go back to is already known
+   uint16_t step = lane.draining ? lane.retryStep : lane.inFlight[lane.head].step;
+
+   lane.numInFlight = 0;
+   lane.draining = false;
+   Retry(lane, step);
+
+   if (lane.result != NodeBusy) return;
+
+   //Replies to the requests that timed out may still come and look like replies to the
+   //requests sent again. Nodes answer in order, so once the reply to a read of the serial
+   //number is in, which is never requested otherwise, all older replies are through.
+   REQUEST& sync = lane.inFlight[lane.head];
+
+   sync.frame.cmd = SDO_READ;
+   sync.frame.index = SDO_INDEX_SERIAL;
+   sync.frame.subIndex = 0;
+   sync.frame.data = 0;
+   sync.step = step;
+   lane.numInFlight = 1;
+   lane.draining = true;
+   lane.sentTime = now;
+   canSdo->SDORequest(lane.nodeId, &sync.frame);
+}
+
+//Build the request of the current step, skips steps that are not needed
+bool Provisioner::MakeRequest(LANE& lane, SdoServer::SdoFrame& frame, bool& barrier)
+{
+   frame.cmd = SDO_READ;
+   frame.data = 0;
+
+   if (&lane == &master)
+   {
+      if (lane.step == 0)
+      {
+         frame.index = SDO_INDEX_CHECKSUM;
+         frame.subIndex = 0;
+         barrier = true;
+      }
+      else if (lane.step < MASTER_STEP_MAPS)
+      {
+         uint16_t id = image.params[lane.step - 1].id;
+         frame.index = SDO_INDEX_PARAM_UID | (id >> 8);
+         frame.subIndex = id & 0xFF;
+      }
+      else if (lane.step == MASTER_STEP_MAPS)
+      {
+         frame.index = SDO_INDEX_MAP_RD + (lane.readRx ? 0x80 : 0) + lane.readMsg;
+         frame.subIndex = lane.readSub;
+         barrier = true;
+      }
+      else
+      {
+         return false;
+      }
+      return true;
+   }
+
+   if (lane.step >= StepParams() && lane.step < StepClear() && lane.paramsOk)
+      lane.step = StepClear();
+   if (lane.step >= StepClear() && lane.step < StepVerify() && lane.mapsOk)
+      lane.step = StepVerify();
+   if (lane.step == StepSave() && lane.paramsOk)
+      lane.step++;
+   if (lane.step == StepSave() + 1 && lane.mapsOk)
+      lane.step++;
+
+   if (lane.step == 0)
+   {
+      frame.index = SDO_INDEX_CHECKSUM;
+      frame.subIndex = 0;
+      barrier = true;
+   }
+   else if (lane.step < StepSums())
+   {
+      uint16_t id = skip[lane.step - 1];
+      frame.index = SDO_INDEX_PARAM_UID | (id >> 8);
+      frame.subIndex = id & 0xFF;
+   }
+   else if (lane.step < StepParams() || (lane.step >= StepVerify() && lane.step < StepSave()))
+   {
+      bool sums = lane.step < StepParams();
+      frame.index = SDO_INDEX_CHECKSUM;
+      frame.subIndex = 1 + lane.step - (sums ? StepSums() : StepVerify());
+      barrier = frame.subIndex == 2;
+   }
+   else if (lane.step < StepClear())
+   {
+      const PARAMVALUE& param = image.params[lane.step - StepParams()];
+      frame.cmd = SDO_WRITE;
+      frame.index = SDO_INDEX_PARAM_UID | (param.id >> 8);
+      frame.subIndex = param.id & 0xFF;
+      frame.data = param.value;
+   }
+   else if (lane.step == StepClear())
+   {
+      frame.cmd = SDO_WRITE;
+      frame.index = SDO_INDEX_COMMAND;
+      frame.subIndex = 6;
+   }
+   else if (lane.step < StepVerify())
+   {
+      int n = lane.step - StepMaps();
+      const MAPITEM& mapItem = image.maps[n / 3];
+      frame.cmd = SDO_WRITE;
+      frame.index = mapItem.rx ? SDO_INDEX_MAP_RX : SDO_INDEX_MAP_TX;
+      frame.subIndex = n % 3;
+      frame.data = n % 3 == 0 ? mapItem.cobId : n % 3 == 1 ? mapItem.item : mapItem.gain;
+   }
+   else if (lane.step < StepEnd())
+   {
+      //Sub index 0 saves the parameters, 1 the maps
+      frame.cmd = SDO_WRITE;
+      frame.index = SDO_INDEX_COMMAND;
+      frame.subIndex = lane.step - StepSave();
+   }
+   else
+   {
+      return false;
+   }
+   return true;
+}
+
+bool Provisioner::HandleMasterReply(LANE& lane, uint16_t step, const SdoServer::SdoFrame* reply)
+{
+   if (step == MASTER_STEP_MAPS)
+      return HandleMapRead(lane, reply);
+
+   if (reply->cmd == SDO_ABORT) return false;
+
+   if (step == 0)
+   {
+      //The master must have the parameter list we are about to read
+      if (reply->data != Param::GetIdSum())
+      {
+         Finish(lane, NodeFailed);
+         return true;
+      }
+      image.idSum = reply->data;
+      lane.step = 1;
+      lane.waiting = false;
+   }
+   else
+   {
+      image.params[step - 1].value = reply->data;
+   }
+   return true;
+}
+
+bool Provisioner::HandleTargetReply(LANE& lane, uint16_t step, const SdoServer::SdoFrame* reply)
+{
+   bool abort = reply->cmd == SDO_ABORT;
+
+   if (step == 0)
+   {
+      if (abort) return false;
+
+      //Different firmware, the parameter ids of the image may not match
+      if (reply->data != image.idSum)
+      {
+         Finish(lane, NodeFailed);
+         return true;
+      }
+      lane.step = 1;
+      lane.waiting = false;
+   }
+   else if (step < StepSums())
+   {
+      if (abort) return false;
+
+      lane.paramSum += SdoServer::ParamChecksum(skip[step - 1], reply->data);
+   }
+   else if (step < StepParams() || (step >= StepVerify() && step < StepSave()))
+   {
+      bool sums = step < StepParams();
+      uint32_t sum = reply->data;
+
+      if (reply->subIndex == 1)
+      {
+         if (abort) return false;
+
+         lane.readWord = sum;
+         return true;
+      }
+
+      //A node without a CAN map matches an image without map items
+      if (abort && image.numMaps > 0) return false;
+      if (abort) sum = 0;
+
+      bool paramsOk = lane.readWord == lane.paramSum;
+      bool mapsOk = sum == mapSum;
+
+      if (sums)
+      {
+         lane.paramsOk = paramsOk;
+         lane.mapsOk = mapsOk;
+         lane.step = StepParams();
+
+         if (paramsOk && mapsOk)
+            Finish(lane, NodeUnchanged);
+      }
+      else if (paramsOk && mapsOk)
+      {
+         lane.step = StepSave();
+      }
+      else if (++lane.attempts > retries)
+      {
+         Finish(lane, NodeFailed);
+      }
+      else
+      {
+         //Write again whatever does not match, also the parts that matched before
+         lane.paramsOk &= paramsOk;
+         lane.mapsOk &= mapsOk;
+         lane.step = StepParams();
+      }
+      lane.waiting = false;
+   }
+   else if (abort)
+   {
+      return false;
+   }
+   return true;
+}
+
+//One message after the other, sub index 0 is the CAN id, then two per item
+bool Provisioner::HandleMapRead(LANE& lane, const SdoServer::SdoFrame* reply)
+{
+   bool nextMessage = reply->cmd == SDO_ABORT; //unused message slot or end of message
+
+   lane.waiting = false;
+
+   if (nextMessage)
+   {
+      //no further handling
+   }
+   else if (lane.readSub == 0)
+   {
+      lane.readCobId = reply->data;
+   }
+   else if (lane.readSub & 1)
+   {
+      lane.readWord = reply->data;
+   }
+   else
+   {
+      if (image.numMaps == PROVISION_MAX_MAP_ITEMS)
+      {
+         Finish(lane, NodeFailed);
+         return true;
+      }
+
+      MAPITEM& mapItem = image.maps[image.numMaps++];
+      mapItem.rx = lane.readRx;
+      mapItem.cobId = lane.readCobId;
+      mapItem.item = lane.readWord;
+      mapItem.gain = reply->data;
+   }
+
+   if (!nextMessage)
+   {
+      lane.readSub++;
+   }
+   else if (++lane.readMsg < MAX_MESSAGES)
+   {
+      lane.readSub = 0;
+   }
+   else if (!lane.readRx)
+   {
+      lane.readRx = true;
+      lane.readMsg = 0;
+      lane.readSub = 0;
+   }
+   else
+   {
+      lane.step = MASTER_STEP_END;
+   }
+   return true;
+}
+
+//Go back to the step that failed, after the replies to later requests are in
+void Provisioner::Retry(LANE& lane, uint16_t step)
+{
+   lane.waiting = false;
+
+   if (++lane.attempts > retries)
+   {
+      Finish(lane, NodeFailed);
+      return;
+   }
+
+   //The node only keeps the COB id and item of sub 0 and 1 until sub 2 adds the item,
+   //so a map item is always written again from its sub 0
+   if (&lane != &master && step >= StepMaps() && step < StepVerify())
+      step = StepMaps() + (step - StepMaps()) / 3 * 3;
+
+   lane.retryStep = step;
+   lane.draining = lane.numInFlight > 0;
+
+   if (!lane.draining)
+      lane.step = step;
+}
+
+void Provisioner::Finish(LANE& lane, uint8_t result)
+{
+   lane.result = result;
+
+   if (&lane != &master && nodeCallback != nullptr)
+      nodeCallback(lane.nodeId, result != NodeFailed);
+}
+
+bool Provisioner::IsSkipped(uint16_t id)
+{
+   for (int i = 0; i < numSkip; i++)
+   {
+      if (skip[i] == id) return true;
+   }
+   return false;
+}
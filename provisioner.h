@@ -0,0 +1,176 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PROVISIONER_H
+#define PROVISIONER_H
+#include "cansdo.h"
+
+//Target nodes provisioned at the same time
+#ifndef PROVISION_MAX_NODES
+#define PROVISION_MAX_NODES     8
+#endif
+
+//Map items in an image
+#ifndef PROVISION_MAX_MAP_ITEMS
+#define PROVISION_MAX_MAP_ITEMS 64
+#endif
+
+//Upper limit of SetWindow()
+#define PROVISION_MAX_WINDOW    8
+
+/* Copies the parameters and CAN maps of one node to many nodes running the same firmware.
+   The configuration is an image that is read from a master node via SDO, taken from
+   this node with LoadLocal() or restored with SetImage(), e.g. from a file.
+   All targets are written at the same time with up to "window" requests in flight
+   per node. Each target is first compared to the image via the checksums in 0x5008,
+   only what differs is written. After writing the checksums are read again and
+   the target is told to save its parameters and maps.
+   Parameters in the skip list, e.g. the node id, are neither read nor written.
+   Map items are always written again from sub index 0.
+   Call Run() from loop(), the node callback reports the result of each target.
+ */
+class Provisioner: ISdoClient
+{
+   public:
+      enum states
+      {
+         Idle,
+         Reading,   //reading the image from the master
+         Writing,
+         Done,
+         Failed
+      };
+
+      enum nodestates
+      {
+         NodeBusy,
+         NodeDone,
+         NodeUnchanged, //already had the configuration of the image
+         NodeFailed
+      };
+
+      struct PARAMVALUE
+      {
+         uint16_t id;
+         uint32_t value;
+      };
+
+      //The words of 0x31xx, sub index 0, odd and even sub index
+      struct MAPITEM
+      {
+         uint32_t cobId;
+         uint32_t item;
+         uint32_t gain;
+         bool rx;
+      };
+
+      struct IMAGE
+      {
+         uint32_t idSum;    //Param::GetIdSum() of the firmware
+         uint16_t numParams;
+         uint16_t numMaps;
+         PARAMVALUE params[Param::NUM_PARAMS];
+         MAPITEM maps[PROVISION_MAX_MAP_ITEMS];
+      };
+
+      explicit Provisioner(CanSdo* sdo);
+      void SetSkip(const uint16_t* ids, int count) { skip = ids; numSkip = count; }
+      bool LoadLocal(CanMap* canMap);
+      void SetImage(const IMAGE& img) { image = img; imageValid = true; }
+      const IMAGE& GetImage() { return image; }
+      bool Start(uint8_t masterId, const uint8_t* targets, int count, uint32_t time);
+      void Abort();
+      enum states Run(uint32_t time);
+      enum states GetState() { return state; }
+      enum nodestates GetNodeState(int target) { return (enum nodestates)lanes[target].result; }
+      void SetWindow(uint8_t n) { window = n < 1 ? 1 : n > PROVISION_MAX_WINDOW ? PROVISION_MAX_WINDOW : n; }
+      void SetRetries(uint8_t n) { retries = n; }
+      void SetTimeout(uint16_t ms) { timeout = ms; }
+      void SetNodeCallback(void (*callback)(uint8_t nodeId, bool success)) { nodeCallback = callback; }
+      void HandleSdoReply(uint8_t nodeId, const SdoServer::SdoFrame* reply) override;
+
+   private:
+      struct REQUEST
+      {
+         SdoServer::SdoFrame frame;
+         uint16_t step;
+      };
+
+      //Requests to one node, the master or a target
+      struct LANE
+      {
+         uint8_t nodeId;
+         uint8_t result;
+         uint16_t step;       //next step to send
+         REQUEST inFlight[PROVISION_MAX_WINDOW];
+         uint8_t head;
+         uint8_t numInFlight;
+         uint32_t sentTime;   //of the oldest request in flight
+         uint8_t attempts;
+         bool waiting;        //sent a step whose reply decides how to go on
+         bool draining;       //dropping the replies after an abort or timeout
+         uint16_t retryStep;
+         bool paramsOk;
+         bool mapsOk;
+         uint32_t paramSum;   //expected parameter checksum of this node
+         uint32_t readWord;
+         bool readRx;         //map read back from the master
+         uint8_t readMsg;
+         uint8_t readSub;
+         uint32_t readCobId;
+      };
+
+      CanSdo* canSdo;
+      IMAGE image;
+      bool imageValid;
+      const uint16_t* skip;
+      uint8_t numSkip;
+      LANE master;
+      LANE lanes[PROVISION_MAX_NODES];
+      uint8_t numLanes;
+      enum states state;
+      uint8_t window;
+      uint8_t retries;
+      uint16_t timeout;
+      bool clientAdded;
+      uint32_t now;
+      uint32_t paramSum;      //of the image
+      uint32_t mapSum;
+      void (*nodeCallback)(uint8_t nodeId, bool success);
+
+      void StartTargets();
+      void InitLane(LANE& lane, uint8_t nodeId);
+      void Pump(LANE& lane);
+      void CheckTimeout(LANE& lane);
+      bool MakeRequest(LANE& lane, SdoServer::SdoFrame& frame, bool& barrier);
+      bool HandleMasterReply(LANE& lane, uint16_t step, const SdoServer::SdoFrame* reply);
+      bool HandleTargetReply(LANE& lane, uint16_t step, const SdoServer::SdoFrame* reply);
+      bool HandleMapRead(LANE& lane, const SdoServer::SdoFrame* reply);
+      void Retry(LANE& lane, uint16_t step);
+      void Finish(LANE& lane, uint8_t result);
+      bool IsSkipped(uint16_t id);
+      uint16_t StepSums() { return 1 + numSkip; }
+      uint16_t StepParams() { return StepSums() + 2; }
+      uint16_t StepClear() { return StepParams() + image.numParams; }
+      uint16_t StepMaps() { return StepClear() + 1; }
+      uint16_t StepVerify() { return StepMaps() + 3 * image.numMaps; }
+      uint16_t StepSave() { return StepVerify() + 2; }
+      uint16_t StepEnd() { return StepSave() + 2; }
+};
+
+#endif // PROVISIONER_H
@@ -0,0 +1,461 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "remotemapper.h"
+
+/** \brief Remote map client
+ *
+ * \param sdo CanSdo whose client side sends the requests
+ *
+ */
+RemoteMapper::RemoteMapper(CanSdo* sdo)
+ : canSdo(sdo), mappings(0), numMappings(0), numLanes(0), state(Idle), window(1), retries(2),
+   timeout(100), verify(true), clientAdded(false), now(0), numDone(0), numFailed(0),
+   progressCallback(nullptr)
+{
+}
+
+/** \brief Start configuring the remote nodes
+ *
+ * \param table mappings, must stay valid until done
+ * \param count number of mappings, at most REMOTEMAP_MAX_MAPPINGS
+ * \param time current time in ms, e.g. millis()
+ * \return false: already running, table too long or more than REMOTEMAP_MAX_NODES nodes
+ *
+ */
+bool RemoteMapper::Start(const MAPPING* table, int count, uint32_t time)
+{
+   if (state == Running || count > REMOTEMAP_MAX_MAPPINGS) return false;
+
+   numLanes = 0;
+
+   for (int i = 0; i < count; i++)
+   {
+      int lane;
+
+      for (lane = 0; lane < numLanes && lanes[lane].nodeId != table[i].nodeId; lane++);
+
+      if (lane == numLanes)
+      {
+         if (numLanes == REMOTEMAP_MAX_NODES) return false;
+
+         lanes[lane].nodeId = table[i].nodeId;
+         numLanes++;
+      }
+      status[i] = Queued;
+      attempts[i] = 0;
+   }
+
+   if (!clientAdded)
+      clientAdded = canSdo->AddClient(this);
+
+   mappings = table;
+   numMappings = count;
+   numDone = numFailed = 0;
+   now = time;
+   state = Running;
+
+   for (int i = 0; i < numLanes; i++)
+   {
+      lanes[i].phase = Writing;
+      lanes[i].head = 0;
+      lanes[i].numInFlight = 0;
+      lanes[i].cursor = 0;
+      lanes[i].step = 0;
+      Pump(lanes[i]);
+   }
+   return true;
+}
+
+void RemoteMapper::Abort()
+{
+   if (state == Running)
+      state = Failed;
+}
+
+/** \brief Handle timeouts and send further requests, call from loop()
+ *
+ * \param time current time in ms, e.g. millis()
+ * \return state after processing
+ *
+ */
+enum RemoteMapper::states RemoteMapper::Run(uint32_t time)
+{
+   if (state != Running) return state;
+
+   now = time;
+   bool finished = true;
+
+   for (int i = 0; i < numLanes; i++)
+   {
+      LANE& lane = lanes[i];
+
+      if (lane.numInFlight > 0 && (time - lane.sentTime) > timeout)
+      {
+         if (lane.phase == Writing)
+         {
+            //A sub index 2 that got no reply may have added the item already. Sending it
+            //again would add it twice, so it is left to the read back to find out
+            for (int j = 0; j < lane.numInFlight; j++)
+            {
+               const REQUEST& request = lane.inFlight[(lane.head + j) % REMOTEMAP_MAX_WINDOW];
+
+               if (request.frame.subIndex == 2 && status[request.mapping] == Sending && attempts[request.mapping] == request.attempt)
+                  status[request.mapping] = Written;
+            }
+
+            for (int j = 0; j < lane.numInFlight; j++)
+            {
+               const REQUEST& request = lane.inFlight[(lane.head + j) % REMOTEMAP_MAX_WINDOW];
+
+               if (status[request.mapping] == Sending && attempts[request.mapping] == request.attempt)
+                  Retry(request.mapping);
+            }
+            Rewind(lane);
+         }
+         else if (lane.deleting)
+         {
+            //The item may or may not be gone, reading again tells
+            RestartVerify(lane);
+         }
+         else if (++lane.readRetries > retries)
+         {
+            //The node stopped answering, give up on what is left to verify
+            for (int j = 0; j < numMappings; j++)
+            {
+               if (mappings[j].nodeId == lane.nodeId && status[j] == Written)
+                  Complete(j, Error);
+            }
+            lane.phase = Finished;
+         }
+         lane.numInFlight = 0;
+      }
+
+      Pump(lane);
+      finished &= lane.phase == Finished;
+   }
+
+   if (finished)
+      state = numFailed > 0 ? Failed : Done;
+
+   return state;
+}
+
+void RemoteMapper::HandleSdoReply(uint8_t nodeId, const SdoServer::SdoFrame* reply)
+{
+   if (state != Running) return;
+
+   for (int i = 0; i < numLanes; i++)
+   {
+      LANE& lane = lanes[i];
+
+      if (lane.nodeId != nodeId || lane.numInFlight == 0) continue;
+
+      REQUEST request = lane.inFlight[lane.head];
+
+      //Stray reply, e.g. to a request that has timed out
+      if (reply->index != request.frame.index || reply->subIndex != request.frame.subIndex) return;
+
+      lane.head = (lane.head + 1) % REMOTEMAP_MAX_WINDOW;
+      lane.numInFlight--;
+      lane.sentTime = now;
+
+      if (lane.phase == Writing)
+         HandleWriteReply(lane, request, reply);
+      else
+         HandleReadReply(lane, reply);
+
+      //Send the next request right away instead of waiting for Run()
+      Pump(lane);
+      return;
+   }
+}
+
+/****************** Private methods ********************/
+
+//Fill the window of the lane
+void RemoteMapper::Pump(LANE& lane)
+{
+   while (lane.phase == Writing && lane.numInFlight < window)
+   {
+      while (lane.cursor < numMappings && (mappings[lane.cursor].nodeId != lane.nodeId ||
+             (lane.step == 0 ? status[lane.cursor] != Queued : status[lane.cursor] != Sending)))
+      {
+         lane.cursor++;
+         lane.step = 0;
+      }
+
+      if (lane.cursor >= numMappings)
+      {
+         if (lane.numInFlight > 0) return;
+
+         //Without verification only items that may have been added twice are read back
+         if (HasStatus(lane, Written))
+            StartVerify(lane);
+         else
+            lane.phase = Finished;
+         break;
+      }
+
+      const MAPPING& mapping = mappings[lane.cursor];
+      uint16_t index = mapping.rx ? SDO_INDEX_MAP_RX : SDO_INDEX_MAP_TX;
+      //mapParam is the id of the remote value
+      uint32_t data = lane.step == 0 ? mapping.cobId : lane.step == 1 ? SdoServer::MapItemWord(mapping.pos.mapParam, &mapping.pos)
+                                                                      : SdoServer::MapGainWord(&mapping.pos);
+
+      status[lane.cursor] = Sending;
+      Send(lane, lane.cursor, index, lane.step, SDO_WRITE, data);
+
+      if (++lane.step > 2)
+      {
+         lane.step = 0;
+         lane.cursor++;
+      }
+   }
+
+   if (lane.phase == Verifying && lane.numInFlight == 0)
+   {
+      uint16_t index = SDO_INDEX_MAP_RD + (lane.readRx ? 0x80 : 0) + lane.readMsg;
+
+      //Writing 0 removes the item
+      if (lane.deleting)
+         Send(lane, 0, index, lane.readSub, SDO_WRITE, 0);
+      else
+         Send(lane, 0, index, lane.readSub, SDO_READ, 0);
+   }
+}
+
+void RemoteMapper::Send(LANE& lane, uint16_t mapping, uint16_t index, uint8_t subIndex, uint8_t cmd, uint32_t data)
+{
+   REQUEST& request = lane.inFlight[(lane.head + lane.numInFlight) % REMOTEMAP_MAX_WINDOW];
+
+   request.frame.cmd = cmd;
+   request.frame.index = index;
+   request.frame.subIndex = subIndex;
+   request.frame.data = data;
+   request.mapping = mapping;
+   request.attempt = attempts[mapping];
+
+   if (lane.numInFlight == 0)
+      lane.sentTime = now;
+
+   lane.numInFlight++;
+   canSdo->SDORequest(lane.nodeId, &request.frame);
+}
+
+void RemoteMapper::HandleWriteReply(LANE& lane, const REQUEST& request, const SdoServer::SdoFrame* reply)
+{
+   //Reply to an earlier attempt of a mapping that has been queued again
+   if (status[request.mapping] != Sending || attempts[request.mapping] != request.attempt) return;
+
+   if (reply->cmd == SDO_ABORT)
+   {
+      Retry(request.mapping);
+      Rewind(lane);
+   }
+   else if (reply->subIndex == 2)
+   {
+      if (verify)
+         status[request.mapping] = Written;
+      else
+         Complete(request.mapping, Verified);
+   }
+}
+
+//Read back all messages of the remote map, sub index 0 is the CAN id, then two per item
+void RemoteMapper::HandleReadReply(LANE& lane, const SdoServer::SdoFrame* reply)
+{
+   lane.readRetries = 0;
+
+   if (lane.deleting)
+   {
+      //The items of the message have moved, read the whole map again
+      if (reply->cmd == SDO_ABORT)
+         Fail(lane.duplicate);
+
+      RestartVerify(lane);
+      return;
+   }
+
+   if (reply->cmd == SDO_ABORT)
+   {
+      //Unused message slot or end of the message
+      if (!NextReadMessage(lane))
+         FinishVerify(lane);
+      return;
+   }
+
+   if (lane.readSub == 0)
+   {
+      lane.readCobId = reply->data;
+   }
+   else if (lane.readSub & 1)
+   {
+      lane.readWord = reply->data;
+   }
+   else
+   {
+      int duplicate = -1;
+
+      for (int i = 0; i < numMappings; i++)
+      {
+         const MAPPING& mapping = mappings[i];
+
+         //The node rounds the gain word the same way, so it reads back unchanged
+         if (mapping.nodeId == lane.nodeId && (status[i] == Written || status[i] == Verified) &&
+             mapping.rx == lane.readRx && mapping.cobId == lane.readCobId &&
+             SdoServer::MapItemWord(mapping.pos.mapParam, &mapping.pos) == lane.readWord &&
+             SdoServer::MapGainWord(&mapping.pos) == reply->data)
+         {
+            //Each item of the remote map accounts for one mapping
+            if (seen[i])
+            {
+               duplicate = i;
+               continue;
+            }
+
+            seen[i] = true;
+            duplicate = -1;
+
+            if (status[i] == Written)
+               Complete(i, Verified);
+            break;
+         }
+      }
+
+      //All mappings of this item were found before, e.g. a retry added it twice
+      if (duplicate >= 0)
+      {
+         lane.deleting = true;
+         lane.duplicate = duplicate;
+         return;
+      }
+   }
+   lane.readSub++;
+}
+
+void RemoteMapper::StartVerify(LANE& lane)
+{
+   lane.phase = Verifying;
+   lane.readRetries = 0;
+   RestartVerify(lane);
+}
+
+//The whole map is read, so that items added twice are found
+void RemoteMapper::RestartVerify(LANE& lane)
+{
+   lane.readRx = !HasMappings(lane, false);
+   lane.readMsg = 0;
+   lane.readSub = 0;
+   lane.deleting = false;
+
+   for (int i = 0; i < numMappings; i++)
+   {
+      if (mappings[i].nodeId == lane.nodeId)
+         seen[i] = false;
+   }
+}
+
+//Assumes the remote node has as many message slots as we have
+bool RemoteMapper::NextReadMessage(LANE& lane)
+{
+   lane.readSub = 0;
+
+   if (++lane.readMsg < MAX_MESSAGES) return true;
+
+   if (lane.readRx || !HasMappings(lane, true)) return false;
+
+   lane.readRx = true;
+   lane.readMsg = 0;
+   return true;
+}
+
+//Mappings that were acknowledged but are not in the remote map are sent again
+void RemoteMapper::FinishVerify(LANE& lane)
+{
+   for (int i = 0; i < numMappings; i++)
+   {
+      if (mappings[i].nodeId == lane.nodeId && status[i] == Written)
+         Retry(i);
+   }
+
+   lane.phase = HasStatus(lane, Queued) ? Writing : Finished;
+   Rewind(lane);
+}
+
+void RemoteMapper::Retry(uint16_t mapping)
+{
+   attempts[mapping]++;
+
+   if (attempts[mapping] > retries)
+      Complete(mapping, Error);
+   else
+      status[mapping] = Queued;
+}
+
+//A verified mapping whose duplicate could not be removed
+void RemoteMapper::Fail(uint16_t mapping)
+{
+   if (status[mapping] != Verified) return;
+
+   numDone--;
+   Complete(mapping, Error);
+}
+
+void RemoteMapper::Complete(uint16_t mapping, uint8_t result)
+{
+   status[mapping] = result;
+
+   if (result == Verified)
+      numDone++;
+   else
+      numFailed++;
+
+   if (progressCallback != nullptr)
+      progressCallback(numDone, numFailed, numMappings);
+}
+
+void RemoteMapper::Rewind(LANE& lane)
+{
+   //A mapping that is only partly sent starts over
+   if (lane.step > 0 && status[lane.cursor] == Sending)
+      status[lane.cursor] = Queued;
+
+   lane.cursor = 0;
+   lane.step = 0;
+}
+
+bool RemoteMapper::HasMappings(const LANE& lane, bool rx)
+{
+   for (int i = 0; i < numMappings; i++)
+   {
+      if (mappings[i].nodeId == lane.nodeId && mappings[i].rx == rx)
+         return true;
+   }
+   return false;
+}
+
+bool RemoteMapper::HasStatus(const LANE& lane, uint8_t mapStatus)
+{
+   for (int i = 0; i < numMappings; i++)
+   {
+      if (mappings[i].nodeId == lane.nodeId && status[i] == mapStatus)
+         return true;
+   }
+   return false;
+}
@@ -0,0 +1,159 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef REMOTEMAPPER_H
+#define REMOTEMAPPER_H
+#include "cansdo.h"
+
+#ifndef REMOTEMAP_MAX_MAPPINGS
+#define REMOTEMAP_MAX_MAPPINGS 128
+#endif
+
+//Nodes configured at the same time
+#ifndef REMOTEMAP_MAX_NODES
+#define REMOTEMAP_MAX_NODES    8
+#endif
+
+//Upper limit of SetWindow()
+#define REMOTEMAP_MAX_WINDOW   8
+
+/* Configures CAN maps of remote nodes from a table, non-blocking.
+   All nodes in the table are configured at the same time. Per node up to "window"
+   requests are sent without waiting for the reply. A window of 1 is plain CANopen,
+   libopeninv nodes process requests in order of arrival and take any window.
+   A mapping that is aborted or times out is sent again, up to "retries" times.
+   With verification on, the map of each node is read back via 0x31xx after
+   writing and mappings that are missing are sent again. Adding an item is not
+   idempotent, so an item whose last write got no reply is always read back before
+   it is sent again, and items found twice are removed.
+   Call Run() from loop(), progress is reported via the progress callback.
+   Like CanSdo::RemoteMap(), CANPOS::mapParam holds the unique id of the remote value.
+ */
+class RemoteMapper: ISdoClient
+{
+   public:
+      enum states
+      {
+         Idle,
+         Running,
+         Done,
+         Failed
+      };
+
+      struct MAPPING
+      {
+         uint8_t nodeId;
+         bool rx;           //receive map of the remote node
+         uint32_t cobId;
+         CanMap::CANPOS pos;
+      };
+
+      explicit RemoteMapper(CanSdo* sdo);
+      bool Start(const MAPPING* table, int count, uint32_t time);
+      void Abort();
+      enum states Run(uint32_t time);
+      enum states GetState() { return state; }
+      bool IsMapped(int mapping) { return status[mapping] == Verified; }
+      void SetWindow(uint8_t n) { window = n < 1 ? 1 : n > REMOTEMAP_MAX_WINDOW ? REMOTEMAP_MAX_WINDOW : n; }
+      void SetRetries(uint8_t n) { retries = n; }
+      void SetTimeout(uint16_t ms) { timeout = ms; }
+      void SetVerify(bool on) { verify = on; }
+      void SetProgressCallback(void (*callback)(int done, int failed, int total)) { progressCallback = callback; }
+      void HandleSdoReply(uint8_t nodeId, const SdoServer::SdoFrame* reply) override;
+
+   private:
+      enum mapstatus
+      {
+         Queued,
+         Sending,
+         Written,   //acknowledged, waiting for verification
+         Verified,
+         Error
+      };
+
+      enum phases
+      {
+         Writing,
+         Verifying,
+         Finished
+      };
+
+      struct REQUEST
+      {
+         SdoServer::SdoFrame frame;
+         uint16_t mapping;
+         uint8_t attempt;
+      };
+
+      //Requests to one node
+      struct LANE
+      {
+         uint8_t nodeId;
+         uint8_t phase;
+         uint16_t cursor;     //next mapping to write
+         uint8_t step;        //next sub index of that mapping
+         REQUEST inFlight[REMOTEMAP_MAX_WINDOW];
+         uint8_t head;
+         uint8_t numInFlight;
+         uint32_t sentTime;   //of the oldest request in flight
+         uint8_t readRetries;
+         bool deleting;       //removing an item found twice
+         uint16_t duplicate;  //mapping of that item
+         bool readRx;         //map being read back
+         uint8_t readMsg;
+         uint8_t readSub;
+         uint32_t readCobId;
+         uint32_t readWord;   //odd sub index of the item being read back
+      };
+
+      CanSdo* canSdo;
+      const MAPPING* mappings;
+      uint16_t numMappings;
+      uint8_t status[REMOTEMAP_MAX_MAPPINGS];
+      uint8_t attempts[REMOTEMAP_MAX_MAPPINGS];
+      bool seen[REMOTEMAP_MAX_MAPPINGS];   //found in the current read back
+      LANE lanes[REMOTEMAP_MAX_NODES];
+      uint8_t numLanes;
+      enum states state;
+      uint8_t window;
+      uint8_t retries;
+      uint16_t timeout;
+      bool verify;
+      bool clientAdded;
+      uint32_t now;
+      uint16_t numDone;
+      uint16_t numFailed;
+      void (*progressCallback)(int done, int failed, int total);
+
+      void Pump(LANE& lane);
+      void Send(LANE& lane, uint16_t mapping, uint16_t index, uint8_t subIndex, uint8_t cmd, uint32_t data);
+      void HandleWriteReply(LANE& lane, const REQUEST& request, const SdoServer::SdoFrame* reply);
+      void HandleReadReply(LANE& lane, const SdoServer::SdoFrame* reply);
+      void StartVerify(LANE& lane);
+      void RestartVerify(LANE& lane);
+      bool NextReadMessage(LANE& lane);
+      void FinishVerify(LANE& lane);
+      void Retry(uint16_t mapping);
+      void Fail(uint16_t mapping);
+      void Complete(uint16_t mapping, uint8_t result);
+      void Rewind(LANE& lane);
+      bool HasMappings(const LANE& lane, bool rx);
+      bool HasStatus(const LANE& lane, uint8_t mapStatus);
+};
+
+#endif // REMOTEMAPPER_H
@@ -0,0 +1,126 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "sdopipe.h"
+
+#ifndef ARDUINO
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+/** \brief SDO server on file descriptors
+ *
+ * \param server object dictionary to serve
+ * \param readFd requests are read from here
+ * \param writeFd replies are written here, may be the same as readFd
+ *
+ */
+SdoPipe::SdoPipe(SdoServer& server, int readFd, int writeFd)
+ : server(server), readFd(readFd), writeFd(writeFd), rxChunkPos(0), rxChunkLen(0),
+   rxLen(0), rxOverflow(false), txLen(0), txPos(0), txPacket(txBuf, sizeof(txBuf), txLen)
+{
+   fcntl(readFd, F_SETFL, fcntl(readFd, F_GETFL) | O_NONBLOCK);
+   fcntl(writeFd, F_SETFL, fcntl(writeFd, F_GETFL) | O_NONBLOCK);
+}
+
+/** \brief Process the requests that have arrived and write the replies, call periodically */
+void SdoPipe::Task()
+{
+   Flush();
+
+   //Like Console, take no new requests before the previous replies are written.
+   //Bytes already read stay in rxChunk until then
+   while (txLen == 0)
+   {
+      if (rxChunkPos == rxChunkLen)
+      {
+         ssize_t count = read(readFd, rxChunk, sizeof(rxChunk));
+
+         if (count <= 0) break;
+
+         rxChunkPos = 0;
+         rxChunkLen = count;
+      }
+
+      uint8_t c = rxChunk[rxChunkPos++];
+
+      if (c != 0)
+      {
+         if (rxLen < sizeof(rxBuf))
+            rxBuf[rxLen++] = c;
+         else
+            rxOverflow = true;
+      }
+      else
+      {
+         if (!rxOverflow && rxLen > 0)
+            ProcessPacket(rxBuf, rxLen);
+         rxLen = 0;
+         rxOverflow = false;
+         Flush();
+      }
+   }
+
+   server.RebootIfRequested();
+}
+
+/****************** Private methods ********************/
+
+void SdoPipe::Flush()
+{
+   while (txPos < txLen)
+   {
+      ssize_t count = write(writeFd, &txBuf[txPos], txLen - txPos);
+
+      if (count <= 0) return;
+
+      txPos += count;
+   }
+   txLen = txPos = 0;
+}
+
+//Invalid packets are dropped, the client times out and repeats them
+void SdoPipe::ProcessPacket(uint8_t* packet, int len)
+{
+   int out = cobs_decode_packet(packet, len);
+
+   if (out < 1 || packet[0] != PKT_SDO || ((out - 1) % 8) != 0) return;
+
+   //The requests are only executed when all their replies can be sent
+   if (!txPacket.HasSpace(out - 1)) return;
+
+   int replies = server.ProcessBatch(&packet[1], (out - 1) / 8, this);
+
+   if (replies > 0 && txPacket.Begin(PKT_SDO, replies * 8))
+   {
+      txPacket.Put(&packet[1], replies * 8);
+      txPacket.End();
+   }
+}
+
+void SdoPipe::SendReply(const SdoServer::SdoFrame* reply)
+{
+   if (txPacket.Begin(PKT_SDO, sizeof(*reply)))
+   {
+      txPacket.Put(reply, sizeof(*reply));
+      txPacket.End();
+   }
+   Flush();
+}
+
+#endif // ARDUINO
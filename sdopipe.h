@@ -0,0 +1,62 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SDOPIPE_H
+#define SDOPIPE_H
+
+#ifndef ARDUINO
+#include "sdoserver.h"
+#include "cobspacket.h"
+
+#ifndef SDOPIPE_BUF_SIZE
+#define SDOPIPE_BUF_SIZE 1024
+#endif
+
+/* Host build only: serves SdoServer on a pair of file descriptors, e.g. a named pipe,
+   pseudo terminal or socket. Requests are batched in 0x01 packets as with the Console
+   binary mode. Task() never blocks, the descriptors are switched to non-blocking mode.
+ */
+class SdoPipe: ISdoTransport
+{
+   public:
+      SdoPipe(SdoServer& server, int readFd, int writeFd);
+      void Task();
+
+   private:
+      SdoServer& server;
+      int readFd;
+      int writeFd;
+      uint8_t rxChunk[64];
+      uint8_t rxChunkPos;
+      uint8_t rxChunkLen;
+      uint8_t rxBuf[SDOPIPE_BUF_SIZE];
+      uint16_t rxLen;
+      bool rxOverflow;
+      uint8_t txBuf[SDOPIPE_BUF_SIZE];
+      uint16_t txLen;
+      uint16_t txPos;
+      CobsWriter txPacket;
+
+      void Flush();
+      void ProcessPacket(uint8_t* packet, int len);
+      void SendReply(const SdoServer::SdoFrame* reply) override;
+};
+
+#endif // ARDUINO
+
+#endif // SDOPIPE_H
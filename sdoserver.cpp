@@ -0,0 +1,996 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2021 Johannes Huebner <dev@johanneshuebner.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "sdoserver.h"
+#include "my_math.h"
+#include "errormessage.h"
+#include "param_save.h"
+#include "crc32.h"
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+#include <string.h>
+
+#define PRINT_BUF_ENQUEUE(c)  printBuffer[(printByteIn++) & (sizeof(printBuffer) - 1)] = c
+#define PRINT_BUF_DEQUEUE()   printBuffer[(printByteOut++) & (sizeof(printBuffer) - 1)]
+#define PRINT_BUF_EMPTY()     ((printByteOut - printByteIn) == sizeof(printBuffer))
+#define PRINT_TIMEOUT         1000
+
+/** \brief
+ *
+ * \param cm CanMap* that is edited via SDO, 0 to disable map access
+ *
+ */
+SdoServer::SdoServer(CanMap* cm)
+ : canMap(cm), printRequest(-1), printByteIn(0), printByteOut(sizeof(printBuffer)),
+   printTimeout(PRINT_TIMEOUT), mapId(0), pendingArrivals(0), now(0),
+   jsonSize(0), printCallback(nullptr), paramHistory(nullptr), streamRead(nullptr),
+   streamContext(nullptr), rebootRequested(false), streamWrite(nullptr), streamWriteContext(nullptr),
+   blockOrigin(nullptr), blockState(BlockIdle), numObjects(0)
+{
+   memset(pending, 0, sizeof(pending));
+
+   AddObject(SDO_INDEX_PARAMS, SDO_INDEX_PARAMS, SDO_ACCESS_RW, ReadParam, WriteParam);
+   AddObject(SDO_INDEX_PARAM_UID, SDO_INDEX_PARAM_UID + 0xFF, SDO_ACCESS_RW, ReadParam, WriteParam);
+   AddObject(SDO_INDEX_SERIAL, SDO_INDEX_SERIAL, SDO_ACCESS_READ, ReadSerial, 0);
+   AddObject(SDO_INDEX_STRINGS, SDO_INDEX_STRINGS, SDO_ACCESS_READ, ReadStrings, 0);
+   AddObject(SDO_INDEX_COMMAND, SDO_INDEX_COMMAND, SDO_ACCESS_WRITE, 0, WriteCommand);
+   AddObject(SDO_INDEX_ERROR_NUM, SDO_INDEX_ERROR_COUNT, SDO_ACCESS_READ, ReadErrorLog, 0);
+   AddObject(SDO_INDEX_CHECKSUM, SDO_INDEX_CHECKSUM, SDO_ACCESS_READ, ReadChecksum, 0);
+
+   if (canMap != 0)
+   {
+      AddObject(SDO_INDEX_MAP_TX, SDO_INDEX_MAP_RX, SDO_ACCESS_WRITE, 0, WriteCanMap);
+      AddObject(SDO_INDEX_MAP_RD, SDO_INDEX_MAP_RD + 0xFF, SDO_ACCESS_RW, ReadCanMap, DeleteCanMap);
+      AddObject(SDO_INDEX_MAP_OVERFLOW, SDO_INDEX_MAP_OVERFLOW + 0xFF, SDO_ACCESS_RW, ReadOverflow, ResetOverflow);
+   }
+}
+
+//http://www.byteme.org.uk/canopenparent/canopen/sdo-service-data-objects-canopen/
+/** \brief Process an SDO request independent of the transport it arrived on
+ *
+ * \param sdo 8 byte request, replaced by the reply
+ * \param origin transport that receives the reply when user space answers later
+ * \return true: send the reply, false: no reply, user space answers it later or the request was an abort
+ *
+ */
+bool SdoServer::ProcessRequest(SdoFrame* sdo, ISdoTransport* origin)
+{
+   if (blockState != BlockIdle && origin == blockOrigin)
+   {
+      return ProcessBlockDownload(sdo);
+   }
+   else if ((sdo->cmd & 0xE0) == SDO_REQUEST_BLOCK_DOWNLOAD)
+   {
+      return InitiateBlockDownload(sdo, origin);
+   }
+   else if (sdo->cmd == SDO_ABORT)
+   {
+      //Aborts are not confirmed, one from the client ends a segmented upload
+      printRequest = -1;
+      streamRead = nullptr;
+      return false;
+   }
+   else if ((sdo->cmd & SDO_REQUEST_SEGMENT) == SDO_REQUEST_SEGMENT)
+   {
+      const int bytesPerMessage = 7;
+      uint8_t *bytes = (uint8_t*)sdo;
+      int i = 1;
+
+      sdo->cmd = sdo->cmd & SDO_TOGGLE_BIT;
+
+      // Use streaming source, e.g. for JSON transfer
+      if (streamRead != nullptr)
+      {
+         size_t count = streamRead(streamContext, &bytes[1], bytesPerMessage);
+         if (count < (size_t)bytesPerMessage)
+         {
+            for (size_t j = count; j < (size_t)bytesPerMessage; j++)
+            {
+               bytes[1 + j] = 0;
+            }
+            sdo->cmd |= SDO_SIZE_SPECIFIED;
+            sdo->cmd |= (bytesPerMessage - (int)count) << 1;
+            printRequest = -1;
+            streamRead = nullptr;
+         }
+      }
+      // Otherwise use legacy buffer-based approach
+      else
+      {
+         // If buffer is low and we have a print callback, refill it
+         uint32_t bufferUsed = sizeof(printBuffer) - (printByteOut - printByteIn);
+
+         if (printRequest >= 0 && bufferUsed < 32 && printCallback != nullptr)
+         {
+            printCallback();  // Refill buffer on-demand
+         }
+
+         for (; i <= bytesPerMessage && !PRINT_BUF_EMPTY(); i++)
+            bytes[i] = PRINT_BUF_DEQUEUE();
+
+         if (PRINT_BUF_EMPTY())
+         {
+            sdo->cmd |= SDO_SIZE_SPECIFIED;
+            sdo->cmd |= (bytesPerMessage - i + 1) << 1;
+         }
+      }
+   }
+   else
+   {
+      const ODENTRY* entry = FindObject(sdo->index);
+      uint32_t data = sdo->data;
+      uint32_t result;
+
+      if (entry == 0)
+         return DeferToUserSpace(sdo, origin); //Don't send reply when handled by user space
+      else if (sdo->cmd == SDO_READ)
+         result = (entry->access & SDO_ACCESS_READ) ? entry->read(entry->context, sdo->index, sdo->subIndex, data) : SDO_ERR_WRITEONLY;
+      else if (sdo->cmd == SDO_WRITE)
+         result = (entry->access & SDO_ACCESS_WRITE) ? entry->write(entry->context, sdo->index, sdo->subIndex, data) : SDO_ERR_READONLY;
+      else
+         result = SDO_ERR_CMD;
+
+      //Only block downloads stream data to a write handler
+      if (result == SDO_SEGMENTED && sdo->cmd == SDO_WRITE)
+      {
+         streamWrite = nullptr;
+         result = SDO_ERR_CMD;
+      }
+
+      if (result == SDO_OK)
+      {
+         sdo->cmd = sdo->cmd == SDO_READ ? SDO_READ_REPLY : SDO_WRITE_REPLY;
+         sdo->data = data;
+      }
+      else if (result == SDO_SEGMENTED)
+      {
+         sdo->cmd = SDO_RESPONSE_UPLOAD | SDO_SIZE_SPECIFIED;
+         sdo->data = data;
+         printRequest = sdo->subIndex;
+      }
+      else
+      {
+         sdo->cmd = SDO_ABORT;
+         sdo->data = result;
+      }
+   }
+   return true;
+}
+
+/** \brief Process several requests that arrived in one transport packet
+ *
+ * \param frames count requests of 8 bytes each, replaced by the replies
+ * \param count number of requests
+ * \param origin transport that receives replies given later by user space
+ * \return number of replies at the start of frames. Requests answered by user space
+ *         are left out, their reply is sent separately via origin
+ *
+ */
+int SdoServer::ProcessBatch(uint8_t* frames, int count, ISdoTransport* origin)
+{
+   int replies = 0;
+
+   for (int i = 0; i < count; i++)
+   {
+      SdoFrame frame;
+
+      memcpy(&frame, &frames[i * sizeof(SdoFrame)], sizeof(frame));
+
+      if (ProcessRequest(&frame, origin))
+      {
+         memcpy(&frames[replies * sizeof(SdoFrame)], &frame, sizeof(frame));
+         replies++;
+      }
+   }
+   return replies;
+}
+
+/** \brief Add an object or a range of objects to the dictionary
+ *
+ * \param entry indexes, access rights and handlers. Handlers return SDO_OK, SDO_SEGMENTED
+ *        after calling BeginUpload() or an SDO_ERR_ abort code
+ * \return true: added, false: table full or the indexes overlap an existing object
+ *
+ */
+bool SdoServer::RegisterObject(const ODENTRY& entry)
+{
+   if (numObjects >= SDO_MAX_OBJECTS || entry.lastIndex < entry.index) return false;
+
+   //Insertion sort, the table is ordered by first index
+   int pos = numObjects;
+
+   while (pos > 0 && objects[pos - 1].index > entry.index)
+      pos--;
+
+   if ((pos > 0 && objects[pos - 1].lastIndex >= entry.index) ||
+       (pos < numObjects && objects[pos].index <= entry.lastIndex))
+      return false;
+
+   for (int i = numObjects; i > pos; i--)
+      objects[i] = objects[i - 1];
+
+   objects[pos] = entry;
+   numObjects++;
+   return true;
+}
+
+/** \brief Start a segmented upload from a read handler, which then returns SDO_SEGMENTED
+ *
+ * \param read stream source, returns less than maxLen at the end of the data.
+ *        0 to upload what is printed to this IPutChar, see GetPrintRequest()
+ * \param context passed to read
+ *
+ */
+void SdoServer::BeginUpload(size_t (*read)(void*, uint8_t*, size_t), void* context)
+{
+   printTimeout = PRINT_TIMEOUT;
+   printByteIn = 0;
+   printByteOut = sizeof(printBuffer); //both point to the beginning of the physical buffer but virtually they are 64 bytes apart
+   streamRead = read;
+   streamContext = context;
+}
+
+/** \brief Accept a block download in a write handler, which then returns SDO_SEGMENTED.
+ * The handler is called with the size of the download as data.
+ *
+ * \param write data sink, called for every segment. Returns the number of bytes taken,
+ *        the download is aborted when that is less than len
+ * \param context passed to write
+ *
+ */
+void SdoServer::BeginDownload(size_t (*write)(void*, const uint8_t*, size_t), void* context)
+{
+   streamWrite = write;
+   streamWriteContext = context;
+}
+
+void SdoServer::SetHistory(ParamHistory* history)
+{
+   //The objects only exist once a history is attached
+   if (paramHistory == nullptr)
+   {
+      AddObject(SDO_INDEX_HISTORY, SDO_INDEX_HISTORY, SDO_ACCESS_READ, ReadHistory, 0);
+      AddObject(SDO_INDEX_HISTORY_STATS, SDO_INDEX_HISTORY_STATS, SDO_ACCESS_RW, ReadHistoryStats, ResetHistoryStats);
+   }
+   paramHistory = history;
+}
+
+/** \brief Reboot if the last request asked for it, call after its reply has been sent */
+void SdoServer::RebootIfRequested()
+{
+   if (!rebootRequested) return;
+
+   rebootRequested = false;
+   // Trigger system reset (platform-specific)
+   #ifdef ARDUINO
+   NVIC_SystemReset();
+   #endif
+}
+
+/** \brief count down PutChar character send timeout
+ *
+ * \param callingFrequency in ms. This is subtracted from the remaining wait time
+ * \return void
+ *
+ */
+void SdoServer::TriggerTimeout(int callingFrequency)
+{
+   if (printTimeout > 0)
+   {
+      printTimeout -= callingFrequency;
+   }
+   if (printTimeout < 0)
+   {
+      printTimeout = 0;
+   }
+}
+
+void SdoServer::PutChar(char c)
+{
+   if (printTimeout == 0) return; //last call to PutChar resulted in a timeout. Do not recover until the next burst
+
+   printTimeout = PRINT_TIMEOUT;
+   //When print buffer is full, wait
+   while (printByteIn == printByteOut && printTimeout > 0);
+
+   PRINT_BUF_ENQUEUE(c);
+   printRequest = -1; //We can clear the print start trigger as we've obviously started printing
+}
+
+/** \brief Abort user space requests and block downloads that timed out, call from loop()
+ *
+ * \param time current time in ms, e.g. millis()
+ *
+ */
+void SdoServer::Task(uint32_t time)
+{
+   now = time;
+
+   if (blockState != BlockIdle && (time - blockTime) >= SDO_BLOCK_TIMEOUT)
+   {
+      SdoFrame abort;
+
+      AbortBlockDownload(&abort, SDO_ERR_TIMEOUT);
+
+      if (blockOrigin != nullptr)
+         blockOrigin->SendReply(&abort);
+   }
+
+   for (PENDINGSDO& request: pending)
+   {
+      if (request.state != PendingFree && (time - request.start) >= request.timeout)
+      {
+         request.frame.cmd = SDO_ABORT;
+         request.frame.data = SDO_ERR_TIMEOUT;
+         FinishPending(&request, &request.frame);
+      }
+   }
+}
+
+/** \brief Take the oldest request for an object that is not in the table
+ *
+ * \param[out] request copy of the request
+ * \param timeout time in ms from now until the request is aborted, counted by Task()
+ * \return handle for the reply, -1 when no request is waiting
+ *
+ */
+int SdoServer::TakePendingSdo(SdoFrame& request, uint16_t timeout)
+{
+   PENDINGSDO* oldest = OldestPending(PendingWaiting);
+
+   if (oldest == 0) return -1;
+
+   oldest->state = PendingTaken;
+   oldest->start = now;
+   oldest->timeout = timeout;
+   request = oldest->frame;
+   return oldest->seq * SDO_MAX_PENDING + (oldest - pending);
+}
+
+/** \brief Answer a taken request on the transport it came from
+ *
+ * \param handle from TakePendingSdo()
+ * \param reply complete reply frame
+ * \return false if the request has already been answered or aborted
+ *
+ */
+bool SdoServer::SendSdoReply(int handle, const SdoFrame* reply)
+{
+   PENDINGSDO* request = FindPending(handle);
+
+   if (request == 0) return false;
+
+   FinishPending(request, reply);
+   return true;
+}
+
+/** \brief Answer a taken request with an abort
+ *
+ * \param handle from TakePendingSdo()
+ * \param abortCode SDO_ERR_ code
+ * \return false if the request has already been answered or aborted
+ *
+ */
+bool SdoServer::AbortPendingSdo(int handle, uint32_t abortCode)
+{
+   PENDINGSDO* request = FindPending(handle);
+
+   if (request == 0) return false;
+
+   request->frame.cmd = SDO_ABORT;
+   request->frame.data = abortCode;
+   FinishPending(request, &request->frame);
+   return true;
+}
+
+/** \brief Number of requests waiting or taken */
+int SdoServer::GetNumPendingSdo()
+{
+   int count = 0;
+
+   for (const PENDINGSDO& request: pending)
+      count += request.state != PendingFree;
+   return count;
+}
+
+/** \brief Oldest request waiting for user space, answer it in place with SendSdoReply(SdoFrame*) */
+SdoServer::SdoFrame* SdoServer::GetPendingUserspaceSdo()
+{
+   PENDINGSDO* oldest = OldestPending(PendingWaiting);
+
+   return oldest != 0 ? &oldest->frame : 0;
+}
+
+/** \brief Answer the request returned by GetPendingUserspaceSdo() on the transport it came from */
+void SdoServer::SendSdoReply(SdoFrame* sdoFrame)
+{
+   PENDINGSDO* request = OldestPending(PendingWaiting);
+
+   for (PENDINGSDO& candidate: pending)
+   {
+      if (candidate.state != PendingFree && &candidate.frame == sdoFrame)
+         request = &candidate;
+   }
+
+   if (request != 0)
+      FinishPending(request, sdoFrame);
+}
+
+/****************** Private methods ********************/
+
+void SdoServer::AddObject(uint16_t index, uint16_t lastIndex, uint8_t access, ReadFunc read, WriteFunc write)
+{
+   ODENTRY entry = { index, lastIndex, access, read, write, this };
+   RegisterObject(entry);
+}
+
+//Binary search for the last object starting at or below index
+const SdoServer::ODENTRY* SdoServer::FindObject(uint16_t index)
+{
+   int low = 0, high = numObjects;
+
+   while (low < high)
+   {
+      int mid = (low + high) / 2;
+
+      if (objects[mid].index <= index)
+         low = mid + 1;
+      else
+         high = mid;
+   }
+
+   if (low > 0 && objects[low - 1].lastIndex >= index)
+      return &objects[low - 1];
+   return 0;
+}
+
+//Queue the request, or abort it when the queue is full or there is no way to reply later
+bool SdoServer::DeferToUserSpace(SdoFrame* sdo, ISdoTransport* origin)
+{
+   PENDINGSDO* request = OldestPending(PendingFree);
+
+   if (request == 0 || origin == 0)
+   {
+      sdo->cmd = SDO_ABORT;
+      sdo->data = origin == 0 ? SDO_ERR_GENERAL : SDO_ERR_NOMEM;
+      return true;
+   }
+
+   request->frame = *sdo;
+   request->origin = origin;
+   request->start = now;
+   request->arrival = pendingArrivals++;
+   request->timeout = SDO_PENDING_TIMEOUT;
+   request->seq++;
+   request->state = PendingWaiting;
+   return false;
+}
+
+//Block download as in CiA 301, the size must be given. The reply carries the block size.
+//The server supports CRCs, they are only checked when the client announces them too
+bool SdoServer::InitiateBlockDownload(SdoFrame* sdo, ISdoTransport* origin)
+{
+   const ODENTRY* entry = FindObject(sdo->index);
+   uint32_t result;
+
+   streamWrite = nullptr;
+
+   if (blockState != BlockIdle)
+      result = SDO_ERR_GENERAL; //another transport is downloading
+   else if (entry == 0)
+      result = SDO_ERR_INVIDX;
+   else if (!(entry->access & SDO_ACCESS_WRITE))
+      result = SDO_ERR_READONLY;
+   else if ((sdo->cmd & SDO_BLOCK_END) || !(sdo->cmd & SDO_BLOCK_SIZE_SPECIFIED))
+      result = SDO_ERR_CMD;
+   else
+      result = entry->write(entry->context, sdo->index, sdo->subIndex, sdo->data);
+
+   if (result == SDO_SEGMENTED && streamWrite != nullptr)
+   {
+      blockOrigin = origin;
+      blockRemaining = sdo->data;
+      blockTime = now;
+      blockIndex = sdo->index;
+      blockSubIndex = sdo->subIndex;
+      blockCrc = 0;
+      blockUseCrc = (sdo->cmd & SDO_BLOCK_CRC) != 0;
+      blockSeq = 1;
+      blockState = BlockData;
+      sdo->cmd = SDO_RESPONSE_BLOCK_DOWNLOAD | SDO_BLOCK_CRC;
+      sdo->data = SDO_BLOCK_SEGMENTS;
+   }
+   else
+   {
+      sdo->cmd = SDO_ABORT;
+      sdo->data = result == SDO_OK || result == SDO_SEGMENTED ? SDO_ERR_CMD : result;
+   }
+   return true;
+}
+
+//Segments only carry a sequence number, the reply is an acknowledge after each block
+bool SdoServer::ProcessBlockDownload(SdoFrame* sdo)
+{
+   uint8_t* bytes = (uint8_t*)sdo;
+
+   blockTime = now;
+
+   if (bytes[0] == SDO_ABORT)
+   {
+      blockState = BlockIdle;
+      streamWrite = nullptr;
+      return false;
+   }
+
+   if (blockState == BlockEnd)
+   {
+      uint16_t crc = bytes[1] | (bytes[2] << 8);
+
+      if ((bytes[0] & 0xE3) != (SDO_REQUEST_BLOCK_DOWNLOAD | SDO_BLOCK_END))
+         AbortBlockDownload(sdo, SDO_ERR_CMD);
+      else if (blockRemaining > 0)
+         AbortBlockDownload(sdo, SDO_ERR_RANGE);
+      else if (blockUseCrc && crc != blockCrc)
+         AbortBlockDownload(sdo, SDO_ERR_CRC);
+      else
+      {
+         memset(sdo, 0, 8);
+         sdo->cmd = SDO_RESPONSE_BLOCK_DOWNLOAD | SDO_BLOCK_END;
+         blockState = BlockIdle;
+         streamWrite = nullptr;
+      }
+      return true;
+   }
+
+   uint8_t seq = bytes[0] & ~SDO_BLOCK_LAST;
+   bool last = (bytes[0] & SDO_BLOCK_LAST) != 0;
+
+   //Segments after a lost one are dropped, the acknowledge makes the client repeat them
+   if (seq == blockSeq)
+   {
+      size_t len = MIN(blockRemaining, 7U);
+
+      if (len > 0 && streamWrite(streamWriteContext, &bytes[1], len) < len)
+      {
+         AbortBlockDownload(sdo, SDO_ERR_STORE);
+         return true;
+      }
+
+      if (blockUseCrc)
+         blockCrc = crc16_bytes(blockCrc, &bytes[1], len);
+      blockRemaining -= len;
+      blockSeq++;
+
+      if (last)
+         blockState = BlockEnd;
+   }
+
+   if (seq < SDO_BLOCK_SEGMENTS && !last) return false;
+
+   memset(sdo, 0, 8);
+   bytes[0] = SDO_RESPONSE_BLOCK_DOWNLOAD | SDO_BLOCK_ACK;
+   bytes[1] = blockSeq - 1;
+   bytes[2] = SDO_BLOCK_SEGMENTS;
+   blockSeq = 1;
+   return true;
+}
+
+void SdoServer::AbortBlockDownload(SdoFrame* sdo, uint32_t abortCode)
+{
+   sdo->cmd = SDO_ABORT;
+   sdo->index = blockIndex;
+   sdo->subIndex = blockSubIndex;
+   sdo->data = abortCode;
+   blockState = BlockIdle;
+   streamWrite = nullptr;
+}
+
+SdoServer::PENDINGSDO* SdoServer::FindPending(int handle)
+{
+   if (handle < 0) return 0;
+
+   PENDINGSDO* request = &pending[handle % SDO_MAX_PENDING];
+
+   if (request->state != PendingTaken || request->seq != handle / SDO_MAX_PENDING) return 0;
+
+   return request;
+}
+
+//Free slots have no order, any of them is returned
+SdoServer::PENDINGSDO* SdoServer::OldestPending(uint8_t state)
+{
+   PENDINGSDO* oldest = 0;
+
+   for (PENDINGSDO& request: pending)
+   {
+      if (request.state == state && (oldest == 0 || (int32_t)(request.arrival - oldest->arrival) < 0))
+         oldest = &request;
+   }
+   return oldest;
+}
+
+void SdoServer::FinishPending(PENDINGSDO* request, const SdoFrame* reply)
+{
+   request->state = PendingFree;
+   request->origin->SendReply(reply);
+}
+
+//SDO index 0x2000 addresses the parameter by its index, 0x21xx will look it up
+//by its unique ID using subIndex as low byte and xx as high byte of ID
+Param::PARAM_NUM SdoServer::ParamFromIndex(uint16_t index, uint8_t subIndex)
+{
+   if ((index & 0xFF00) == SDO_INDEX_PARAM_UID)
+      return Param::NumFromId(subIndex + ((index & 0xFF) << 8));
+   return (Param::PARAM_NUM)subIndex;
+}
+
+uint32_t SdoServer::ReadParam(void*, uint16_t index, uint8_t subIndex, uint32_t& data)
+{
+   Param::PARAM_NUM paramIdx = ParamFromIndex(index, subIndex);
+
+   if (paramIdx >= Param::PARAM_LAST) return SDO_ERR_INVIDX;
+
+   //Raw values are 32-bit integers, they do not fit the fixed point format
+   if (Param::GetFlag(paramIdx) & Param::FLAG_RAW)
+      data = Param::GetRaw(paramIdx);
+   else
+      data = Param::Get(paramIdx);
+   return SDO_OK;
+}
+
+uint32_t SdoServer::WriteParam(void*, uint16_t index, uint8_t subIndex, uint32_t data)
+{
+   Param::PARAM_NUM paramIdx = ParamFromIndex(index, subIndex);
+
+   if (paramIdx >= Param::PARAM_LAST) return SDO_ERR_INVIDX;
+
+   int result = Param::Stage(paramIdx, data);
+
+   if (result == 0) return SDO_OK;
+
+   return result == -2 ? SDO_ERR_STORE : SDO_ERR_RANGE; //-2: transaction full
+}
+
+//Unique id of the controller in 4 words, 0 on the host. Does not depend on a project parameter
+uint32_t SdoServer::ReadSerial(void*, uint16_t, uint8_t subIndex, uint32_t& data)
+{
+   if (subIndex > 3) return SDO_ERR_INVIDX;
+
+#if defined(ARDUINO) && defined(HW_OCOTP_CFG0)
+   static const volatile uint32_t* const fuses[] = { &HW_OCOTP_CFG0, &HW_OCOTP_CFG1, &HW_OCOTP_MAC0, &HW_OCOTP_MAC1 };
+   data = *fuses[subIndex];
+#else
+   data = 0;
+#endif
+   return SDO_OK;
+}
+
+static size_t ReadJson(void*, uint8_t* out, size_t maxLen)
+{
+   return ParamJson::Read(out, maxLen);
+}
+
+uint32_t SdoServer::ReadStrings(void* context, uint16_t, uint8_t, uint32_t& data)
+{
+   SdoServer* server = (SdoServer*)context;
+
+   ParamJson::BeginStream();
+   server->jsonSize = ParamJson::GetSize();
+   data = server->jsonSize;
+   server->BeginUpload(ReadJson, nullptr);
+   return SDO_SEGMENTED;
+}
+
+uint32_t SdoServer::WriteCommand(void* context, uint16_t, uint8_t subIndex, uint32_t)
+{
+   SdoServer* server = (SdoServer*)context;
+
+   switch (subIndex)
+   {
+   case 0:
+      // Save parameters to flash
+      parm_save();
+      return SDO_OK;
+   case 1:
+      // Save CAN mappings to flash
+      if (server->canMap == nullptr) return SDO_ERR_GENERAL;
+      server->canMap->Save();
+      return SDO_OK;
+   case 2:
+      // Reset/reboot command, the transport reboots after sending the reply
+      server->rebootRequested = true;
+      return SDO_OK;
+   case SDO_CMD_BEGIN:
+      // Begin transaction, parameter writes via SDO are staged until commit
+      Param::Begin();
+      return SDO_OK;
+   case SDO_CMD_COMMIT:
+      return Param::Commit() == 0 ? SDO_OK : SDO_ERR_STORE;
+   case SDO_CMD_ABORT:
+      Param::Abort();
+      return SDO_OK;
+   case 6:
+      // Clear CAN mappings, e.g. before writing a complete new set
+      if (server->canMap == nullptr) return SDO_ERR_GENERAL;
+      server->canMap->Clear();
+      return SDO_OK;
+   default:
+      return SDO_ERR_INVIDX;
+   }
+}
+
+//0x5003: error numbers, 0x5004: times, 0x5005: counts. Sub index 0 is the most recent entry
+uint32_t SdoServer::ReadErrorLog(void*, uint16_t index, uint8_t subIndex, uint32_t& data)
+{
+   if (index == SDO_INDEX_ERROR_NUM)
+      data = ErrorMessage::GetErrorNum(subIndex);
+   else if (index == SDO_INDEX_ERROR_TIME)
+      data = ErrorMessage::GetErrorTime(subIndex);
+   else
+      data = ErrorMessage::GetErrorCount(subIndex);
+   return SDO_OK;
+}
+
+uint32_t SdoServer::ReadHistory(void* context, uint16_t, uint8_t, uint32_t& data)
+{
+   ParamHistory* history = ((SdoServer*)context)->paramHistory;
+
+   if (history == nullptr) return SDO_ERR_INVIDX;
+
+   data = history->BeginRead();
+   ((SdoServer*)context)->BeginUpload(ParamHistory::ReadStream, history);
+   return SDO_SEGMENTED;
+}
+
+//Sub index is channel * 4 + 0: min, 1: max, 2: mean, 3: number of samples
+uint32_t SdoServer::ReadHistoryStats(void* context, uint16_t, uint8_t subIndex, uint32_t& data)
+{
+   ParamHistory* history = ((SdoServer*)context)->paramHistory;
+   int channel = subIndex / 4;
+
+   if (history == nullptr || channel >= history->GetNumChannels()) return SDO_ERR_INVIDX;
+
+   switch (subIndex & 3)
+   {
+   case 0: data = FP_FROMFLT(history->GetMin(channel)); break;
+   case 1: data = FP_FROMFLT(history->GetMax(channel)); break;
+   case 2: data = FP_FROMFLT(history->GetMean(channel)); break;
+   case 3: data = history->GetStatsCount(); break;
+   }
+   return SDO_OK;
+}
+
+//Any write resets the statistics of all channels
+uint32_t SdoServer::ResetHistoryStats(void* context, uint16_t, uint8_t, uint32_t)
+{
+   ParamHistory* history = ((SdoServer*)context)->paramHistory;
+
+   if (history == nullptr) return SDO_ERR_INVIDX;
+
+   history->ResetStats();
+   return SDO_OK;
+}
+
+//0x31xx: bit 7 of xx selects receive maps, the lower bits are the message index
+uint32_t SdoServer::ReadCanMap(void* context, uint16_t index, uint8_t subIndex, uint32_t& data)
+{
+   CanMap* canMap = ((SdoServer*)context)->canMap;
+   bool rx = (index & 0x80) != 0;
+   uint32_t canId;
+   uint8_t itemIdx = MAX(0, subIndex - 1) / 2;
+   const CanMap::CANPOS* canPos = canMap->GetMap(rx, index & 0x3f, itemIdx, canId);
+
+   if (canPos == 0) return SDO_ERR_INVIDX;
+
+   if (subIndex == 0) //0 contains COB Id
+      data = canId;
+   else if (subIndex & 1) //odd sub indexes have data id, position and length
+      data = MapItemWord(canPos);
+   else //even sub indexes except 0 have gain and offset
+      data = MapGainWord(canPos);
+   return SDO_OK;
+}
+
+uint32_t SdoServer::MapItemWord(const CanMap::CANPOS* canPos)
+{
+   return MapItemWord(Param::GetAttrib((Param::PARAM_NUM)canPos->mapParam)->id, canPos);
+}
+
+//With the value id given, e.g. of a value on a remote node
+uint32_t SdoServer::MapItemWord(uint16_t id, const CanMap::CANPOS* canPos)
+{
+   return id | (canPos->offsetBits << 16) | (canPos->type << 22) | ((uint32_t)(uint8_t)canPos->numBits << 24);
+}
+
+//Rounded, so that writing the word back yields the same word again
+uint32_t SdoServer::MapGainWord(const CanMap::CANPOS* canPos)
+{
+   int32_t gain = (int32_t)(canPos->gain * 1000 + (canPos->gain < 0 ? -0.5f : 0.5f));
+
+   return ((uint32_t)gain & 0xFFFFFF) | ((uint32_t)(uint8_t)canPos->offset << 24);
+}
+
+/** \brief Checksum term of one parameter, the checksum is the sum of all terms
+ *
+ * \param id unique parameter id
+ * \param value parameter value as read via SDO
+ * \return uint32_t term
+ *
+ */
+uint32_t SdoServer::ParamChecksum(uint16_t id, uint32_t value)
+{
+   return crc32_word(crc32_word(CRC32_INIT, id), value);
+}
+
+/** \brief Checksum term of one map item, the checksum is the sum of all terms
+ *
+ * \param rx true for receive maps
+ * \param canId CAN id of the message, sub index 0 of 0x31xx
+ * \param item position word, odd sub index of 0x31xx
+ * \param gain gain word, even sub index of 0x31xx
+ * \return uint32_t term
+ *
+ */
+uint32_t SdoServer::MapChecksum(bool rx, uint32_t canId, uint32_t item, uint32_t gain)
+{
+   return crc32_word(crc32_word(crc32_word(CRC32_INIT, canId | ((uint32_t)rx << 31)), item), gain);
+}
+
+/* 0x5008: sub 0 is the id sum of the parameter list, it is the same for all nodes
+   running the same firmware. Sub 1 is the checksum of the parameters that are saved,
+   sub 2 the checksum of the CAN maps. Both are sums, so they don't depend on order */
+uint32_t SdoServer::ReadChecksum(void* context, uint16_t, uint8_t subIndex, uint32_t& data)
+{
+   CanMap* canMap = ((SdoServer*)context)->canMap;
+
+   switch (subIndex)
+   {
+   case 0:
+      data = Param::GetIdSum();
+      return SDO_OK;
+   case 1:
+      data = 0;
+
+      for (auto param: Param::Params())
+         data += ParamChecksum(Param::GetAttrib(param)->id, Param::Get(param));
+      return SDO_OK;
+   case 2:
+      if (canMap == nullptr) return SDO_ERR_INVIDX;
+
+      data = 0;
+
+      for (int rx = 0; rx < 2; rx++)
+      {
+         for (int msg = 0; msg < MAX_MESSAGES; msg++)
+         {
+            uint32_t canId;
+            const CanMap::CANPOS* canPos;
+
+            for (int item = 0; (canPos = canMap->GetMap(rx, msg, item, canId)) != 0; item++)
+               data += MapChecksum(rx, canId, MapItemWord(canPos), MapGainWord(canPos));
+         }
+      }
+      return SDO_OK;
+   default:
+      return SDO_ERR_INVIDX;
+   }
+}
+
+//Writing 0 to any sub index of an item removes it
+uint32_t SdoServer::DeleteCanMap(void* context, uint16_t index, uint8_t subIndex, uint32_t data)
+{
+   CanMap* canMap = ((SdoServer*)context)->canMap;
+   bool rx = (index & 0x80) != 0;
+   uint32_t canId;
+   uint8_t itemIdx = MAX(0, subIndex - 1) / 2;
+
+   if (data != 0 || canMap->GetMap(rx, index & 0x3f, itemIdx, canId) == 0) return SDO_ERR_INVIDX;
+
+   canMap->Remove(rx, index & 0x3f, itemIdx);
+   return SDO_OK;
+}
+
+//Sub index is the item index in the send message
+uint32_t SdoServer::ReadOverflow(void* context, uint16_t index, uint8_t subIndex, uint32_t& data)
+{
+   CanMap* canMap = ((SdoServer*)context)->canMap;
+   uint32_t canId;
+   const CanMap::CANPOS* canPos = canMap->GetMap(false, index & 0x3f, subIndex, canId);
+
+   if (canPos == 0) return SDO_ERR_INVIDX;
+
+   data = canMap->GetOverflowCount(canPos);
+   return SDO_OK;
+}
+
+//Writing 0 resets the counter
+uint32_t SdoServer::ResetOverflow(void* context, uint16_t index, uint8_t subIndex, uint32_t data)
+{
+   CanMap* canMap = ((SdoServer*)context)->canMap;
+   uint32_t canId;
+   const CanMap::CANPOS* canPos = canMap->GetMap(false, index & 0x3f, subIndex, canId);
+
+   if (canPos == 0) return SDO_ERR_INVIDX;
+   if (data != 0) return SDO_ERR_RANGE;
+
+   canMap->ResetOverflowCount(canPos);
+   return SDO_OK;
+}
+
+//0x3000: send map, 0x3001: receive map. Sub index 0 takes the CAN id, 1 the value id,
+//position, type and length, 2 gain and offset, which adds the item
+uint32_t SdoServer::WriteCanMap(void* context, uint16_t index, uint8_t subIndex, uint32_t data)
+{
+   SdoServer* server = (SdoServer*)context;
+   CanMap::CANPOS& mapInfo = server->mapInfo;
+   uint32_t& mapId = server->mapId;
+   int result = -1;
+
+   if (subIndex == 0)
+   {
+      if (data < 0x20000000 || (data & ~CAN_FORCE_EXTENDED) < 0x800)
+      {
+         mapId = data;
+         result = 0;
+      }
+      else
+      {
+         mapId = 0xFFFFFFFF;
+      }
+   }
+   else if (mapId != 0xFFFFFFFF && subIndex == 1)
+   {
+      //Now we receive UID of value to be mapped along with bit start and length
+      mapInfo.mapParam = Param::NumFromId(data & 0xFFFF);
+      mapInfo.offsetBits = (data >> 16) & 0x3F;
+      mapInfo.type = (data >> 22) & 0x3;
+
+      //A pipelined sub index 2 may already be on its way, it must not add an unknown value
+      if (mapInfo.mapParam < Param::PARAM_LAST)
+      {
+         mapInfo.numBits = ((int32_t)data >> 24);
+         result = 0;
+      }
+      else
+      {
+         mapInfo.numBits = 0;
+         mapId = 0xFFFFFFFF;
+      }
+   }
+   else if (mapInfo.numBits != 0 && subIndex == 2) //This sort of verifies that we received subindex 1
+   {
+      //Now we receive gain and offset and add the map
+
+      // sign extend the 24-bit integer to a 32-bit integer
+      int32_t gainFixedPoint = (data & 0xFFFFFF) << (32-24);
+      gainFixedPoint >>= (32-24);
+      mapInfo.gain = gainFixedPoint / 1000.0f;
+      mapInfo.offset = data >> 24;
+
+      if (index == SDO_INDEX_MAP_RX) //RX map
+         result = server->canMap->AddRecv((Param::PARAM_NUM)mapInfo.mapParam, mapId, mapInfo.offsetBits, mapInfo.numBits, mapInfo.gain, mapInfo.offset, (CanMap::itemtypes)mapInfo.type);
+      else
+         result = server->canMap->AddSend((Param::PARAM_NUM)mapInfo.mapParam, mapId, mapInfo.offsetBits, mapInfo.numBits, mapInfo.gain, mapInfo.offset, (CanMap::itemtypes)mapInfo.type);
+
+      mapInfo.numBits = 0;
+      mapId = 0xFFFFFFFF;
+   }
+
+   return result >= 0 ? SDO_OK : SDO_ERR_INVIDX;
+}
@@ -0,0 +1,276 @@
+/*
+ * This file is part of the libopeninv project.
+ *
+ * Copyright (C) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SDOSERVER_H
+#define SDOSERVER_H
+#include "params.h"
+#include "printf.h"
+#include "canmap.h"
+#include "param_json.h"
+#include "param_history.h"
+
+#define SDO_REQUEST_DOWNLOAD  (1 << 5)
+#define SDO_REQUEST_UPLOAD    (2 << 5)
+#define SDO_REQUEST_SEGMENT   (3 << 5)
+#define SDO_TOGGLE_BIT        (1 << 4)
+#define SDO_RESPONSE_UPLOAD   (2 << 5)
+#define SDO_RESPONSE_DOWNLOAD (3 << 5)
+#define SDO_EXPEDITED         (1 << 1)
+#define SDO_SIZE_SPECIFIED    (1)
+#define SDO_WRITE             (SDO_REQUEST_DOWNLOAD | SDO_EXPEDITED | SDO_SIZE_SPECIFIED)
+#define SDO_READ              SDO_REQUEST_UPLOAD
+#define SDO_ABORT             0x80
+#define SDO_WRITE_REPLY       SDO_RESPONSE_DOWNLOAD
+#define SDO_READ_REPLY        (SDO_RESPONSE_UPLOAD | SDO_EXPEDITED | SDO_SIZE_SPECIFIED)
+#define SDO_REQUEST_BLOCK_DOWNLOAD  (6 << 5)
+#define SDO_RESPONSE_BLOCK_DOWNLOAD (5 << 5)
+#define SDO_BLOCK_CRC         (1 << 2)
+#define SDO_BLOCK_SIZE_SPECIFIED (1 << 1)
+#define SDO_BLOCK_END         1
+#define SDO_BLOCK_ACK         2
+#define SDO_BLOCK_LAST        0x80 //in the sequence number byte of the last segment
+#define SDO_ERR_TIMEOUT       0x05040000
+#define SDO_ERR_CMD           0x05040001
+#define SDO_ERR_SEQNO         0x05040003
+#define SDO_ERR_CRC           0x05040004
+#define SDO_ERR_NOMEM         0x05040005
+#define SDO_ERR_WRITEONLY     0x06010001
+#define SDO_ERR_READONLY      0x06010002
+#define SDO_ERR_INVIDX        0x06020000
+#define SDO_ERR_RANGE         0x06090030
+#define SDO_ERR_GENERAL       0x08000000
+#define SDO_ERR_STORE         0x08000020
+
+#define SDO_INDEX_PARAMS      0x2000
+#define SDO_INDEX_PARAM_UID   0x2100
+#define SDO_INDEX_MAP_TX      0x3000
+#define SDO_INDEX_MAP_RX      0x3001
+#define SDO_INDEX_MAP_RD      0x3100
+#define SDO_INDEX_MAP_OVERFLOW 0x3200
+#define SDO_INDEX_SERIAL      0x5000
+#define SDO_INDEX_STRINGS     0x5001
+#define SDO_INDEX_COMMAND     0x5002
+#define SDO_INDEX_ERROR_NUM   0x5003
+#define SDO_INDEX_ERROR_TIME  0x5004
+#define SDO_INDEX_ERROR_COUNT 0x5005
+#define SDO_INDEX_HISTORY     0x5006
+#define SDO_INDEX_HISTORY_STATS 0x5007
+#define SDO_INDEX_CHECKSUM    0x5008
+
+//Sub indexes of SDO_INDEX_COMMAND for parameter transactions, 3 to 5 are
+//load defaults, start and stop in the openinverter tools
+#define SDO_CMD_BEGIN         0x10
+#define SDO_CMD_COMMIT        0x11
+#define SDO_CMD_ABORT         0x12
+
+//Object handler results besides the SDO_ERR_ abort codes
+#define SDO_OK                0
+#define SDO_SEGMENTED         1 //read handler has called BeginUpload(), data is the size
+                                //or write handler has called BeginDownload()
+
+#define SDO_ACCESS_READ       1
+#define SDO_ACCESS_WRITE      2
+#define SDO_ACCESS_RW         (SDO_ACCESS_READ | SDO_ACCESS_WRITE)
+
+//Size of the object table, the built in objects take 15 entries
+#ifndef SDO_MAX_OBJECTS
+#define SDO_MAX_OBJECTS       32
+#endif
+
+//Requests waiting for user space, more are aborted right away
+#ifndef SDO_MAX_PENDING
+#define SDO_MAX_PENDING       4
+#endif
+
+//Segments per block download, the client waits for an acknowledge after each block
+#ifndef SDO_BLOCK_SEGMENTS
+#define SDO_BLOCK_SEGMENTS    127
+#endif
+
+//Block downloads without a segment for this long are aborted, in ms
+#ifndef SDO_BLOCK_TIMEOUT
+#define SDO_BLOCK_TIMEOUT     1000
+#endif
+
+//Pending requests not answered within this time are aborted, in ms
+#ifndef SDO_PENDING_TIMEOUT
+#define SDO_PENDING_TIMEOUT   1000
+#endif
+
+class ISdoTransport;
+
+/* The SDO object dictionary, independent of the transport the requests arrive on.
+   CanSdo serves it on CAN, CanSdoPort on further CAN buses, Console and SdoPipe
+   accept batches of requests in one serial or pipe packet.
+   All transports share one dictionary, so parameter writes, maps and commands
+   are the same everywhere. Objects are kept in a table sorted by index, further
+   objects can be added with RegisterObject(). Requests for indexes that are not
+   in the table go to a queue for user space, see TakePendingSdo().
+   Segmented uploads share one print buffer, so only one transport should run a
+   JSON or history upload at a time. Likewise there is one block download at a time,
+   while it runs all frames from its transport are taken as its segments.
+ */
+class SdoServer: public IPutChar
+{
+   public:
+      struct SdoFrame
+      {
+         uint8_t cmd;
+         uint16_t index;
+         uint8_t subIndex;
+         uint32_t data;
+      } __attribute__((packed));
+
+      typedef uint32_t (*ReadFunc)(void* context, uint16_t index, uint8_t subIndex, uint32_t& data);
+      typedef uint32_t (*WriteFunc)(void* context, uint16_t index, uint8_t subIndex, uint32_t data);
+
+      struct ODENTRY
+      {
+         uint16_t index;     //first index
+         uint16_t lastIndex; //last index of a range, same as index for a single object
+         uint8_t access;     //SDO_ACCESS_ flags
+         ReadFunc read;
+         WriteFunc write;
+         void* context;      //passed to the handlers
+      };
+
+      explicit SdoServer(CanMap* cm = 0);
+      bool ProcessRequest(SdoFrame* sdo, ISdoTransport* origin = 0);
+      int ProcessBatch(uint8_t* frames, int count, ISdoTransport* origin = 0);
+      bool RegisterObject(const ODENTRY& entry);
+      void BeginUpload(size_t (*read)(void*, uint8_t*, size_t), void* context);
+      void BeginDownload(size_t (*write)(void*, const uint8_t*, size_t), void* context);
+      void RebootIfRequested();
+      void Task(uint32_t time);
+      int TakePendingSdo(SdoFrame& request, uint16_t timeout = SDO_PENDING_TIMEOUT);
+      bool SendSdoReply(int handle, const SdoFrame* reply);
+      bool AbortPendingSdo(int handle, uint32_t abortCode);
+      int GetNumPendingSdo();
+      int GetPrintRequest() { return printRequest; }
+      SdoFrame* GetPendingUserspaceSdo();
+      void SendSdoReply(SdoFrame* sdoFrame);
+      void PutChar(char c) override;
+      void TriggerTimeout(int callingFrequency);
+      void SetJsonSize(uint32_t size) { jsonSize = size; }
+      void SetPrintCallback(void (*callback)()) { printCallback = callback; }
+      void SetHistory(ParamHistory* history);
+      static uint32_t ParamChecksum(uint16_t id, uint32_t value);
+      static uint32_t MapChecksum(bool rx, uint32_t canId, uint32_t item, uint32_t gain);
+      static uint32_t MapItemWord(const CanMap::CANPOS* canPos);
+      static uint32_t MapItemWord(uint16_t id, const CanMap::CANPOS* canPos);
+      static uint32_t MapGainWord(const CanMap::CANPOS* canPos);
+
+   protected:
+      CanMap* canMap;
+
+   private:
+      enum pendingstates
+      {
+         PendingFree,
+         PendingWaiting, //not yet taken by user space
+         PendingTaken
+      };
+
+      enum blockstates
+      {
+         BlockIdle,
+         BlockData,
+         BlockEnd       //last segment received, waiting for the end request
+      };
+
+      struct PENDINGSDO
+      {
+         SdoFrame frame;
+         ISdoTransport* origin; //the reply goes back there
+         uint32_t start;
+         uint32_t arrival;      //orders the requests
+         uint16_t timeout;
+         uint8_t seq;           //part of the handle, detects handles of finished requests
+         uint8_t state;
+      };
+
+      int printRequest;
+      //We use a ring buffer with non-wrapping index. This limits us to 4 GB, huh!
+      //In the beginning printBufIn starts at 0 and printBufOut at sizeof(printBuffer) (e.g. 64)
+      //All addressing of printBuffer is modulo buffer size
+      volatile char printBuffer[64]; //Must be a power of 2 for efficient modulo calculation
+      volatile uint32_t printByteIn;
+      volatile uint32_t printByteOut;
+      volatile int printTimeout; //remaining time to wait
+      uint32_t mapId;
+      CanMap::CANPOS mapInfo;
+      PENDINGSDO pending[SDO_MAX_PENDING];
+      uint32_t pendingArrivals;
+      uint32_t now;
+      uint32_t jsonSize;
+      void (*printCallback)();
+      ParamHistory* paramHistory;
+      //Source of the segmented upload in progress, 0 when uploading from the print buffer
+      size_t (*streamRead)(void* context, uint8_t* out, size_t maxLen);
+      void* streamContext;
+      bool rebootRequested;
+      //Block download in progress
+      size_t (*streamWrite)(void* context, const uint8_t* data, size_t len);
+      void* streamWriteContext;
+      ISdoTransport* blockOrigin;
+      uint32_t blockRemaining;
+      uint32_t blockTime;
+      uint16_t blockIndex;
+      uint16_t blockCrc;
+      bool blockUseCrc;     //the client announced CRC support as well
+      uint8_t blockSubIndex;
+      uint8_t blockSeq;     //next expected sequence number
+      uint8_t blockState;
+      ODENTRY objects[SDO_MAX_OBJECTS];
+      uint8_t numObjects;
+
+      void AddObject(uint16_t index, uint16_t lastIndex, uint8_t access, ReadFunc read, WriteFunc write);
+      const ODENTRY* FindObject(uint16_t index);
+      bool DeferToUserSpace(SdoFrame* sdo, ISdoTransport* origin);
+      bool InitiateBlockDownload(SdoFrame* sdo, ISdoTransport* origin);
+      bool ProcessBlockDownload(SdoFrame* sdo);
+      void AbortBlockDownload(SdoFrame* sdo, uint32_t abortCode);
+      PENDINGSDO* FindPending(int handle);
+      PENDINGSDO* OldestPending(uint8_t state);
+      void FinishPending(PENDINGSDO* request, const SdoFrame* reply);
+      static Param::PARAM_NUM ParamFromIndex(uint16_t index, uint8_t subIndex);
+      static uint32_t ReadParam(void* context, uint16_t index, uint8_t subIndex, uint32_t& data);
+      static uint32_t WriteParam(void* context, uint16_t index, uint8_t subIndex, uint32_t data);
+      static uint32_t ReadSerial(void* context, uint16_t index, uint8_t subIndex, uint32_t& data);
+      static uint32_t ReadStrings(void* context, uint16_t index, uint8_t subIndex, uint32_t& data);
+      static uint32_t WriteCommand(void* context, uint16_t index, uint8_t subIndex, uint32_t data);
+      static uint32_t ReadErrorLog(void* context, uint16_t index, uint8_t subIndex, uint32_t& data);
+      static uint32_t ReadHistory(void* context, uint16_t index, uint8_t subIndex, uint32_t& data);
+      static uint32_t ReadHistoryStats(void* context, uint16_t index, uint8_t subIndex, uint32_t& data);
+      static uint32_t ResetHistoryStats(void* context, uint16_t index, uint8_t subIndex, uint32_t data);
+      static uint32_t ReadChecksum(void* context, uint16_t index, uint8_t subIndex, uint32_t& data);
+      static uint32_t ReadCanMap(void* context, uint16_t index, uint8_t subIndex, uint32_t& data);
+      static uint32_t DeleteCanMap(void* context, uint16_t index, uint8_t subIndex, uint32_t data);
+      static uint32_t ReadOverflow(void* context, uint16_t index, uint8_t subIndex, uint32_t& data);
+      static uint32_t ResetOverflow(void* context, uint16_t index, uint8_t subIndex, uint32_t data);
+      static uint32_t WriteCanMap(void* context, uint16_t index, uint8_t subIndex, uint32_t data);
+};
+
+/* A way of sending SDO replies, implemented by every transport that serves SdoServer */
+class ISdoTransport
+{
+   public:
+      virtual void SendReply(const SdoServer::SdoFrame* reply) = 0;
+};
+
+#endif // SDOSERVER_H
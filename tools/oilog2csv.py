@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+#
+# This file is part of the libopeninv project.
+#
+# Copyright (C) 2026
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+"""Convert a DataLogger binary log to CSV.
+
+The first row holds the column names as "name[unit]", so the output can be
+loaded directly with pandas.read_csv() and saved as Parquet from there.
+"""
+
+import argparse
+import csv
+import struct
+import sys
+
+MAGIC = 0x474C494F
+VERSION = 1
+
+
+def read_string(data, pos):
+    end = data.index(b"\0", pos)
+    return data[pos:end].decode("latin-1"), end + 1
+
+
+def parse_header(data):
+    magic, version, num_channels, record_size, interval = struct.unpack_from("<IBBHI", data, 0)
+
+    if magic != MAGIC:
+        raise ValueError("not a libopeninv log file")
+    if version != VERSION:
+        raise ValueError("unsupported log version %d" % version)
+
+    pos = 12
+    channels = []
+
+    for _ in range(num_channels):
+        param_id, param_type = struct.unpack_from("<HB", data, pos)
+        name, pos = read_string(data, pos + 3)
+        unit, pos = read_string(data, pos)
+        channels.append((param_id, param_type, name, unit))
+
+    if record_size != 4 + 4 * num_channels:
+        raise ValueError("record size does not match channel count")
+
+    return channels, record_size, interval, pos
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("log", help="binary log file written by DataLogger")
+    parser.add_argument("csv", nargs="?", help="output file, default stdout")
+    args = parser.parse_args()
+
+    with open(args.log, "rb") as f:
+        data = f.read()
+
+    channels, record_size, interval, pos = parse_header(data)
+    record = struct.Struct("<I%df" % len(channels))
+    out = open(args.csv, "w", newline="") if args.csv else sys.stdout
+    writer = csv.writer(out)
+
+    writer.writerow(["time"] + ["%s[%s]" % (c[2], c[3]) if c[3] else c[2] for c in channels])
+
+    while pos + record_size <= len(data):
+        values = record.unpack_from(data, pos)
+        writer.writerow([values[0]] + ["%g" % v for v in values[1:]])
+        pos += record_size
+
+    if pos != len(data):
+        print("warning: %d trailing bytes ignored" % (len(data) - pos), file=sys.stderr)
+
+    if out is not sys.stdout:
+        out.close()
+
+
+if __name__ == "__main__":
+    main()